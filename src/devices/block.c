@@ -116,6 +116,56 @@ void block_write(struct block *block, block_sector_t sector,
     block->write_cnt++;
 }
 
+/*! Reads the CNT sectors starting at SECTOR from BLOCK into BUFFER, which
+    must have room for CNT * BLOCK_SECTOR_SIZE bytes.  Drivers that support
+    it transfer the whole run in one command.
+    Internally synchronizes accesses to block devices, so external
+    per-block device locking is unneeded. */
+void block_read_multiple(struct block *block, block_sector_t sector,
+                         size_t cnt, void *buffer) {
+    size_t i;
+
+    if (cnt == 0)
+        return;
+    check_sector(block, sector);
+    check_sector(block, sector + cnt - 1);
+    if (block->ops->read_multiple != NULL) {
+        block->ops->read_multiple(block->aux, sector, cnt, buffer);
+        block->read_cnt += cnt;
+    }
+    else {
+        for (i = 0; i < cnt; i++)
+            block_read(block, sector + i,
+                       (uint8_t *) buffer + i * BLOCK_SECTOR_SIZE);
+    }
+}
+
+/*! Writes the CNT sectors starting at SECTOR to BLOCK from BUFFER, which
+    must contain CNT * BLOCK_SECTOR_SIZE bytes.  Drivers that support it
+    transfer the whole run in one command.  Returns after the block device
+    has acknowledged receiving the data.
+    Internally synchronizes accesses to block devices, so external
+    per-block device locking is unneeded. */
+void block_write_multiple(struct block *block, block_sector_t sector,
+                          size_t cnt, const void *buffer) {
+    size_t i;
+
+    if (cnt == 0)
+        return;
+    check_sector(block, sector);
+    check_sector(block, sector + cnt - 1);
+    if (block->ops->write_multiple != NULL) {
+        ASSERT(block->type != BLOCK_FOREIGN);
+        block->ops->write_multiple(block->aux, sector, cnt, buffer);
+        block->write_cnt += cnt;
+    }
+    else {
+        for (i = 0; i < cnt; i++)
+            block_write(block, sector + i,
+                        (const uint8_t *) buffer + i * BLOCK_SECTOR_SIZE);
+    }
+}
+
 /*! Returns the number of sectors in BLOCK. */
 block_sector_t block_size(struct block *block) {
     return block->size;
@@ -57,6 +57,10 @@
 #define CMD_WRITE_SECTOR_RETRY 0x30     /*!< WRITE SECTOR with retries. */
 /*! @} */
 
+/*! Most sectors one READ SECTOR or WRITE SECTOR command can transfer.  A
+    sector count of 0 in the Sector Count register stands for 256. */
+#define MAX_CMD_SECTORS 256
+
 /*! An ATA device. */
 struct ata_disk {
     char name[8];               /*!< Name, e.g. "hda". */
@@ -90,7 +94,7 @@ static void reset_channel(struct channel *);
 static bool check_device_type(struct ata_disk *);
 static void identify_ata_device(struct ata_disk *);
 
-static void select_sector(struct ata_disk *, block_sector_t);
+static void select_sectors(struct ata_disk *, block_sector_t, size_t cnt);
 static void issue_pio_command(struct channel *, uint8_t command);
 static void input_sector(struct channel *, void *);
 static void output_sector(struct channel *, const void *);
@@ -315,53 +319,103 @@ static char * descramble_ata_string(char *string, int size) {
     return string;
 }
 
-/*! Reads sector SEC_NO from disk D into BUFFER, which must have room for
-    BLOCK_SECTOR_SIZE bytes.  Internally synchronizes accesses to disks,
-    so external per-disk locking is unneeded. */
-static void ide_read(void *d_, block_sector_t sec_no, void *buffer) {
+/*! Reads the CNT sectors starting at SEC_NO from disk D into BUFFER, which
+    must have room for CNT * BLOCK_SECTOR_SIZE bytes.  Each command reads up
+    to MAX_CMD_SECTORS sectors, with an interrupt as each one is ready.
+    Internally synchronizes accesses to disks, so external per-disk locking
+    is unneeded. */
+static void ide_read_multiple(void *d_, block_sector_t sec_no, size_t cnt,
+                              void *buffer) {
     struct ata_disk *d = d_;
     struct channel *c = d->channel;
+    uint8_t *sector = buffer;
+
     lock_acquire(&c->lock);
-    select_sector(d, sec_no);
-    issue_pio_command(c, CMD_READ_SECTOR_RETRY);
-    sema_down(&c->completion_wait);
-    if (!wait_while_busy(d))
-        PANIC("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-    input_sector(c, buffer);
+    while (cnt > 0) {
+        size_t cmd_cnt = cnt < MAX_CMD_SECTORS ? cnt : MAX_CMD_SECTORS;
+        size_t i;
+
+        select_sectors(d, sec_no, cmd_cnt);
+        issue_pio_command(c, CMD_READ_SECTOR_RETRY);
+        for (i = 0; i < cmd_cnt; i++, sector += BLOCK_SECTOR_SIZE) {
+            sema_down(&c->completion_wait);
+            if (!wait_while_busy(d))
+                PANIC("%s: disk read failed, sector=%"PRDSNu,
+                      d->name, sec_no + i);
+            input_sector(c, sector);
+        }
+        sec_no += cmd_cnt;
+        cnt -= cmd_cnt;
+    }
     lock_release(&c->lock);
 }
 
+/*! Writes the CNT sectors starting at SEC_NO to disk D from BUFFER, which
+    must contain CNT * BLOCK_SECTOR_SIZE bytes.  Each command writes up to
+    MAX_CMD_SECTORS sectors, with an interrupt as each one is taken.
+    Returns after the disk has acknowledged receiving the data.  Internally
+    synchronizes accesses to disks, so external per-disk locking is
+    unneeded. */
+static void ide_write_multiple(void *d_, block_sector_t sec_no, size_t cnt,
+                               const void *buffer) {
+    struct ata_disk *d = d_;
+    struct channel *c = d->channel;
+    const uint8_t *sector = buffer;
+
+    lock_acquire(&c->lock);
+    while (cnt > 0) {
+        size_t cmd_cnt = cnt < MAX_CMD_SECTORS ? cnt : MAX_CMD_SECTORS;
+        size_t i;
+
+        select_sectors(d, sec_no, cmd_cnt);
+        issue_pio_command(c, CMD_WRITE_SECTOR_RETRY);
+        for (i = 0; i < cmd_cnt; i++, sector += BLOCK_SECTOR_SIZE) {
+            if (!wait_while_busy(d))
+                PANIC("%s: disk write failed, sector=%"PRDSNu,
+                      d->name, sec_no + i);
+            output_sector(c, sector);
+            sema_down(&c->completion_wait);
+        }
+        sec_no += cmd_cnt;
+        cnt -= cmd_cnt;
+    }
+    lock_release(&c->lock);
+}
+
+/*! Reads sector SEC_NO from disk D into BUFFER, which must have room for
+    BLOCK_SECTOR_SIZE bytes.  Internally synchronizes accesses to disks,
+    so external per-disk locking is unneeded. */
+static void ide_read(void *d_, block_sector_t sec_no, void *buffer) {
+    ide_read_multiple(d_, sec_no, 1, buffer);
+}
+
 /*! Write sector SEC_NO to disk D from BUFFER, which must contain
     BLOCK_SECTOR_SIZE bytes.  Returns after the disk has acknowledged
     receiving the data.  Internally synchronizes accesses to disks, so external
     per-disk locking is unneeded. */
 static void ide_write(void *d_, block_sector_t sec_no, const void *buffer) {
-    struct ata_disk *d = d_;
-    struct channel *c = d->channel;
-    lock_acquire(&c->lock);
-    select_sector(d, sec_no);
-    issue_pio_command(c, CMD_WRITE_SECTOR_RETRY);
-    if (!wait_while_busy(d))
-        PANIC("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-    output_sector(c, buffer);
-    sema_down(&c->completion_wait);
-    lock_release(&c->lock);
+    ide_write_multiple(d_, sec_no, 1, buffer);
 }
 
 static struct block_operations ide_operations = {
     ide_read,
-    ide_write
+    ide_write,
+    ide_read_multiple,
+    ide_write_multiple
 };
 
 /*! Selects device D, waiting for it to become ready, and then writes SEC_NO
-    to the disk's sector selection registers.  (We use LBA mode.) */
-static void select_sector(struct ata_disk *d, block_sector_t sec_no) {
+    and the count CNT of sectors to transfer to the disk's sector selection
+    registers.  (We use LBA mode.) */
+static void select_sectors(struct ata_disk *d, block_sector_t sec_no,
+                           size_t cnt) {
     struct channel *c = d->channel;
 
     ASSERT(sec_no < (1UL << 28));
-  
+    ASSERT(cnt > 0 && cnt <= MAX_CMD_SECTORS);
+
     select_device_wait(d);
-    outb(reg_nsect(c), 1);
+    outb(reg_nsect(c), cnt == MAX_CMD_SECTORS ? 0 : cnt);
     outb(reg_lbal(c), sec_no);
     outb(reg_lbam(c), sec_no >> 8);
     outb(reg_lbah(c), (sec_no >> 16));
@@ -15,9 +15,6 @@
 #define PIT_PORT_COUNTER(CHANNEL) (0x40 + (CHANNEL))  /*!< Counter port. */
 /*! @} */
 
-/*! PIT cycles per second. */
-#define PIT_HZ 1193180
-
 /*! Configure the given CHANNEL in the PIT.  In a PC, the PIT's
     three output channels are hooked up like this:
 
@@ -79,3 +76,44 @@ void pit_configure_channel(int channel, int mode, int frequency) {
     intr_set_level(old_level);
 }
 
+/*! Starts the given CHANNEL counting down COUNT PIT cycles in mode 0,
+    "interrupt on terminal count".  The channel's output stays 0 until the
+    count reaches zero, then goes to 1 and stays there, so channel 0 raises
+    exactly one timer interrupt.  A COUNT of 0 is treated by the PIT as 65536.
+
+    The channel must be put back into its periodic mode with
+    pit_configure_channel() afterward. */
+void pit_start_oneshot(int channel, uint16_t count) {
+    enum intr_level old_level;
+
+    ASSERT(channel == 0 || channel == 2);
+
+    old_level = intr_disable();
+    outb(PIT_PORT_CONTROL, (channel << 6) | 0x30);
+    outb(PIT_PORT_COUNTER(channel), count);
+    outb(PIT_PORT_COUNTER(channel), count >> 8);
+    intr_set_level(old_level);
+}
+
+/*! Returns the number of PIT cycles left to count on the given CHANNEL.  If
+    EXPIRED is non-null, sets it to the state of the channel's output, which
+    for a channel started by pit_start_oneshot() is true once the count has
+    reached zero.  Uses the 8254 read-back command, which latches the status
+    and count together so that they are consistent with each other. */
+uint16_t pit_read_count(int channel, bool *expired) {
+    enum intr_level old_level;
+    uint8_t status, low, high;
+
+    ASSERT(channel == 0 || channel == 2);
+
+    old_level = intr_disable();
+    outb(PIT_PORT_CONTROL, 0xc0 | (2 << channel));
+    status = inb(PIT_PORT_COUNTER(channel));
+    low = inb(PIT_PORT_COUNTER(channel));
+    high = inb(PIT_PORT_COUNTER(channel));
+    intr_set_level(old_level);
+
+    if (expired != NULL)
+        *expired = (status & 0x80) != 0;
+    return ((uint16_t) high << 8) | low;
+}
@@ -13,6 +13,9 @@
 #include "devices/block.h"
 #include "filesys/filesys.h"
 #endif
+#ifdef VM
+#include "vm/falloc.h"
+#endif
 
 /*! Keyboard control register port. */
 #define CONTROL_REG 0x64
@@ -114,5 +117,8 @@ static void print_stats(void) {
 #ifdef USERPROG
     exception_print_stats();
 #endif
+#ifdef VM
+    falloc_print_stats();
+#endif
 }
 
@@ -29,7 +29,28 @@ static unsigned loops_per_tick;
 /*! Flag to control use of multi-level feedback queue scheduler */
 extern bool thread_mlfqs;
 
+/*! Ticks since the last once per second mlfqs update. */
+static int mlfqs_second_ticks;
+
+/*! If false (default), the timer interrupts TIMER_FREQ times per second at
+    all times.  If true, the timer is stopped while the CPU is idle, see
+    timer_idle_enter().  Controlled by kernel command-line option
+    "-tickless". */
+bool timer_tickless;
+
+/*! PIT cycles per timer tick. */
+#define TICK_CYCLES ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/*! Longest idle period, in ticks, that fits in the PIT's 16-bit counter. */
+#define TICKLESS_MAX_TICKS (65535 / TICK_CYCLES)
+
+/*! Number of ticks the PIT was programmed to stay quiet for by
+    timer_idle_enter(), or 0 if it is running periodically. */
+static int64_t tickless_ticks;
+
 static intr_handler_func timer_interrupt;
+static void timer_catch_up(int64_t elapsed);
+static void timer_mlfqs_update(void);
 static bool too_many_loops(unsigned loops);
 static void busy_wait(int64_t loops);
 static void real_time_sleep(int64_t num, int32_t denom);
@@ -139,23 +160,113 @@ void timer_print_stats(void) {
     printf("Timer: %"PRId64" ticks\n", timer_ticks());
 }
 
+/*! Stops the periodic timer while the CPU is idle.  Called by the idle
+    thread, with interrupts off, just before it halts.  If tickless mode is
+    enabled, the PIT is reprogrammed to interrupt once, on the tick that the
+    next sleeping thread is due to awaken, instead of on every tick.  The
+    ticks skipped are made up by timer_interrupt(), or by timer_idle_exit()
+    if some other interrupt wakes the CPU first. */
+void timer_idle_enter(void) {
+    int64_t idle_ticks;
+
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    if (!timer_tickless || tickless_ticks != 0)
+        return;
+
+    /* The tick whose interrupt awakens the next sleeper is the
+       (next - ticks + 1)'th from now. */
+    idle_ticks = thread_next_awaken() - ticks + 1;
+    if (idle_ticks > TICKLESS_MAX_TICKS)
+        idle_ticks = TICKLESS_MAX_TICKS;
+    if (idle_ticks <= 1)
+        return;
+
+    tickless_ticks = idle_ticks;
+    pit_start_oneshot(0, idle_ticks * TICK_CYCLES);
+}
+
+/*! Restarts the periodic timer after the CPU was woken from a tickless idle
+    period by an interrupt other than the timer's, and accounts for the whole
+    ticks that passed in the meantime.  Called by the idle thread with
+    interrupts off; does nothing if the timer is already periodic. */
+void timer_idle_exit(void) {
+    int64_t elapsed;
+    uint16_t remaining;
+    bool expired;
+
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    if (tickless_ticks == 0)
+        return;
+
+    remaining = pit_read_count(0, &expired);
+    if (expired) {
+        /* The one-shot interrupt is already pending and will account for
+           the last tick itself. */
+        elapsed = tickless_ticks - 1;
+    }
+    else {
+        elapsed = tickless_ticks * TICK_CYCLES - remaining;
+        elapsed = (elapsed + TICK_CYCLES / 2) / TICK_CYCLES;
+        if (elapsed > tickless_ticks - 1)
+            elapsed = tickless_ticks - 1;
+    }
+
+    tickless_ticks = 0;
+    pit_configure_channel(0, 2, TIMER_FREQ);
+    timer_catch_up(elapsed);
+}
+
 /*! Timer interrupt handler. */
 static void timer_interrupt(struct intr_frame *args UNUSED) {
     
+    /* If waking from a tickless idle period, account for the skipped ticks
+       and go back to periodic interrupts.  The interrupt itself stands for
+       the last tick of the period. */
+    if (tickless_ticks != 0) {
+        int64_t elapsed = tickless_ticks - 1;
+        tickless_ticks = 0;
+        pit_configure_channel(0, 2, TIMER_FREQ);
+        timer_catch_up(elapsed);
+    }
+
     /* Update counters on sleeping threads and awaken as needed. */
     thread_check_awaken ();
     
     /* Update system ticks and thread data */
     ticks++;
     thread_tick();
+    timer_mlfqs_update();
+}
+
+/*! Accounts for ELAPSED ticks spent with the CPU halted in the idle thread,
+    doing the same bookkeeping that many timer interrupts would have. */
+static void timer_catch_up(int64_t elapsed) {
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    while (elapsed-- > 0) {
+        thread_check_awaken ();
+        ticks++;
+        thread_tick_idle();
+        timer_mlfqs_update();
+    }
+}
+
+/*! Updates mlfqs data on the tick that just passed. */
+static void timer_mlfqs_update(void) {
+    if (!thread_mlfqs)
+        return;
 
-    /* Update mlfqs data once per second */
-    if ((thread_mlfqs) && (timer_ticks() % TIMER_FREQ == 0)) {
+    /* Update mlfqs data once per second, counting ticks separately rather
+       than taking a 64-bit remainder of ticks on every interrupt. */
+    if (++mlfqs_second_ticks == TIMER_FREQ) {
+        mlfqs_second_ticks = 0;
         thread_update_recent_cpu();
         thread_update_load_avg();
     }
     /* Update mlfqs priority once every four clocks */
-    if ((thread_mlfqs) && (timer_ticks() % 4 == 0)) {
+    if ((ticks & 3) == 0) {
         thread_update_priority();
     }
 }
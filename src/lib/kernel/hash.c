@@ -31,6 +31,7 @@ hash_init (struct hash *h,
   h->hash = hash;
   h->less = less;
   h->aux = aux;
+  h->fixed = false;
 
   if (h->buckets != NULL) 
     {
@@ -41,6 +42,30 @@ hash_init (struct hash *h,
     return false;
 }
 
+/* Initializes hash table H like hash_init(), but with the
+   BUCKET_CNT lists at BUCKETS instead of memory from malloc().
+   BUCKET_CNT must be a power of 2.  The table is never resized,
+   so it never allocates memory, which suits tables that must be
+   usable where malloc() is not, at the cost of longer chains if
+   it grows well past BUCKET_CNT elements.  hash_destroy() does
+   not free BUCKETS. */
+void
+hash_init_fixed (struct hash *h, struct list *buckets, size_t bucket_cnt,
+                 hash_hash_func *hash, hash_less_func *less, void *aux)
+{
+  ASSERT (buckets != NULL);
+  ASSERT (bucket_cnt > 0 && (bucket_cnt & (bucket_cnt - 1)) == 0);
+
+  h->elem_cnt = 0;
+  h->bucket_cnt = bucket_cnt;
+  h->buckets = buckets;
+  h->hash = hash;
+  h->less = less;
+  h->aux = aux;
+  h->fixed = true;
+  hash_clear (h, NULL);
+}
+
 /* Removes all the elements from H.
    
    If DESTRUCTOR is non-null, then it is called for each element
@@ -88,7 +113,8 @@ hash_destroy (struct hash *h, hash_action_func *destructor)
 {
   if (destructor != NULL)
     hash_clear (h, destructor);
-  free (h->buckets);
+  if (!h->fixed)
+    free (h->buckets);
 }
 
 /* Inserts NEW into hash table H and returns a null pointer, if
@@ -357,6 +383,10 @@ rehash (struct hash *h)
 
   ASSERT (h != NULL);
 
+  /* A table with fixed buckets keeps them. */
+  if (h->fixed)
+    return;
+
   /* Save old bucket info for later use. */
   old_buckets = h->buckets;
   old_bucket_cnt = h->bucket_cnt;
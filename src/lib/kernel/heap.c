@@ -0,0 +1,179 @@
+#include "heap.h"
+#include "../debug.h"
+
+/* Pairing heap.
+
+   See heap.h for basic information.  For the analysis of the
+   amortized bounds, see M. L. Fredman, R. Sedgewick, D. D.
+   Sleator, and R. E. Tarjan, "The Pairing Heap: A New Form of
+   Self-Adjusting Heap", Algorithmica 1 (1986). */
+
+static struct heap_elem *meld (struct heap *, struct heap_elem *,
+                               struct heap_elem *);
+static struct heap_elem *merge_pairs (struct heap *, struct heap_elem *);
+
+/* Initializes H as an empty heap ordered by LESS, given
+   auxiliary data AUX. */
+void
+heap_init (struct heap *h, heap_less_func *less, void *aux)
+{
+  ASSERT (h != NULL);
+  ASSERT (less != NULL);
+
+  h->root = NULL;
+  h->elem_cnt = 0;
+  h->less = less;
+  h->aux = aux;
+}
+
+/* Returns the number of elements in H. */
+size_t
+heap_size (const struct heap *h)
+{
+  return h->elem_cnt;
+}
+
+/* Returns true if H contains no elements, false otherwise. */
+bool
+heap_empty (const struct heap *h)
+{
+  return h->root == NULL;
+}
+
+/* Returns the greatest element in H.  If several elements are
+   equally greatest, returns one of them.  Undefined behavior if
+   H is empty. */
+struct heap_elem *
+heap_max (const struct heap *h)
+{
+  ASSERT (h->root != NULL);
+  return h->root;
+}
+
+/* Inserts E into H. */
+void
+heap_insert (struct heap *h, struct heap_elem *e)
+{
+  ASSERT (e != NULL);
+
+  e->child = NULL;
+  h->root = meld (h, h->root, e);
+  h->elem_cnt++;
+}
+
+/* Removes and returns the greatest element in H.  Undefined
+   behavior if H is empty. */
+struct heap_elem *
+heap_pop_max (struct heap *h)
+{
+  struct heap_elem *max = heap_max (h);
+
+  h->root = merge_pairs (h, max->child);
+  h->elem_cnt--;
+  return max;
+}
+
+/* Removes E, which must be in H, from H. */
+void
+heap_remove (struct heap *h, struct heap_elem *e)
+{
+  ASSERT (h->elem_cnt > 0);
+
+  if (e == h->root)
+    {
+      heap_pop_max (h);
+      return;
+    }
+
+  /* Unlink E, with its children, from its parent and siblings. */
+  if (e->prev->child == e)
+    e->prev->child = e->next;
+  else
+    e->prev->next = e->next;
+  if (e->next != NULL)
+    e->next->prev = e->prev;
+
+  h->root = meld (h, h->root, merge_pairs (h, e->child));
+  h->elem_cnt--;
+}
+
+/* Moves E, which must be in H, to its proper place after its
+   value has changed. */
+void
+heap_update (struct heap *h, struct heap_elem *e)
+{
+  heap_remove (h, e);
+  heap_insert (h, e);
+}
+
+/* Melds the trees rooted at A and B, either of which may be
+   null, and returns the root of the result.  The sibling links
+   of A and B are overwritten. */
+static struct heap_elem *
+meld (struct heap *h, struct heap_elem *a, struct heap_elem *b)
+{
+  struct heap_elem *tmp;
+
+  if (a == NULL)
+    tmp = b;
+  else if (b == NULL)
+    tmp = a;
+  else
+    {
+      /* Keep A on top if it is not less than B, so that of equal
+         elements the one already in the heap stays greatest. */
+      if (h->less (a, b, h->aux))
+        {
+          tmp = a;
+          a = b;
+          b = tmp;
+        }
+
+      /* Make B the first child of A. */
+      b->prev = a;
+      b->next = a->child;
+      if (a->child != NULL)
+        a->child->prev = b;
+      a->child = b;
+      tmp = a;
+    }
+
+  if (tmp != NULL)
+    tmp->next = tmp->prev = NULL;
+  return tmp;
+}
+
+/* Melds the list of sibling trees starting at FIRST into a
+   single tree, by melding them in pairs from left to right and
+   then melding the pairs from right to left, and returns its
+   root, or a null pointer if FIRST is null. */
+static struct heap_elem *
+merge_pairs (struct heap *h, struct heap_elem *first)
+{
+  struct heap_elem *pairs = NULL;
+  struct heap_elem *root = NULL;
+
+  /* First pass: meld adjacent siblings, stacking the results so
+     that the last pair ends up on top. */
+  while (first != NULL)
+    {
+      struct heap_elem *a = first;
+      struct heap_elem *b = a->next;
+      struct heap_elem *pair;
+
+      first = b != NULL ? b->next : NULL;
+      pair = meld (h, a, b);
+      pair->next = pairs;
+      pairs = pair;
+    }
+
+  /* Second pass: meld the pairs from the last to the first. */
+  while (pairs != NULL)
+    {
+      struct heap_elem *next = pairs->next;
+      root = meld (h, root, pairs);
+      pairs = next;
+    }
+
+  return root;
+}
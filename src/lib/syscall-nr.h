@@ -37,7 +37,14 @@ enum {
     SYS_MKDIR,                  /*!< Create a directory. */
     SYS_READDIR,                /*!< Reads a directory entry. */
     SYS_ISDIR,                  /*!< Tests if a fd represents a directory. */
-    SYS_INUMBER                 /*!< Returns the inode number for a fd. */
+    SYS_INUMBER,                /*!< Returns the inode number for a fd. */
+
+    /* Stride scheduler. */
+    SYS_SETTICKETS,             /*!< Set the process's tickets. */
+    SYS_GETTICKETS,             /*!< Get the process's tickets. */
+
+    /* Zeroed memory mappings. */
+    SYS_MMAP_ANON               /*!< Map zeroed memory. */
 };
 
 #endif /* lib/syscall-nr.h */
@@ -153,3 +153,15 @@ int inumber(int fd) {
     return syscall1(SYS_INUMBER, fd);
 }
 
+
+bool settickets(int tickets) {
+    return syscall1(SYS_SETTICKETS, tickets);
+}
+
+int gettickets(void) {
+    return syscall0(SYS_GETTICKETS);
+}
+
+mapid_t mmap_anon(void *addr, unsigned size, int flags) {
+    return syscall3(SYS_MMAP_ANON, addr, size, flags);
+}
@@ -12,6 +12,9 @@ typedef int pid_t;
 typedef int mapid_t;
 #define MAP_FAILED ((mapid_t) -1)
 
+/*! Flags for mmap_anon(). */
+#define MAP_LARGE 0x1           /*!< Use 4 MB pages where possible. */
+
 /*! Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
@@ -45,5 +48,12 @@ bool readdir(int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir(int fd);
 int inumber(int fd);
 
+/* Stride scheduler. */
+bool settickets(int tickets);
+int gettickets(void);
+
+/* Zeroed memory mappings. */
+mapid_t mmap_anon(void *addr, unsigned size, int flags);
+
 #endif /* lib/user/syscall.h */
 
@@ -0,0 +1,107 @@
+/* Creates a large number of threads, each of which sleeps many
+   times for durations spread across several timer wheel levels.
+   Verifies that every thread wakes up on exactly the tick it
+   asked for. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 100          /* Number of sleeping threads. */
+#define ITERATIONS 10           /* Number of sleeps per thread. */
+#define MAX_DURATION 150        /* Longest sleep, in ticks. */
+
+/* Information about an individual thread in the test. */
+struct sleep_thread 
+  {
+    struct semaphore *done;     /* Upped when the thread finishes. */
+    int id;                     /* Sleeper ID. */
+    int wakeups;                /* Number of on-time wakeups. */
+    int64_t bad_tick;           /* Tick of the first wrong wakeup. */
+    int64_t bad_expected;       /* Tick it should have woken up on. */
+  };
+
+static void sleeper (void *);
+
+void
+test_alarm_many (void) 
+{
+  struct sleep_thread *threads;
+  struct semaphore done;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  msg ("Creating %d threads to sleep %d times each.", THREAD_CNT, ITERATIONS);
+  msg ("Sleep durations range from 1 to %d ticks.", MAX_DURATION);
+  msg ("Every thread should wake up on the tick it asked for.");
+
+  threads = malloc (sizeof *threads * THREAD_CNT);
+  if (threads == NULL)
+    PANIC ("couldn't allocate memory for test");
+
+  sema_init (&done, 0);
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      struct sleep_thread *t = threads + i;
+      char name[16];
+
+      t->done = &done;
+      t->id = i;
+      t->wakeups = 0;
+      t->bad_tick = -1;
+      t->bad_expected = -1;
+
+      snprintf (name, sizeof name, "sleeper %d", i);
+      thread_create (name, PRI_DEFAULT, sleeper, t);
+    }
+
+  /* Wait for every thread to finish sleeping. */
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      struct sleep_thread *t = threads + i;
+      if (t->wakeups != ITERATIONS)
+        fail ("thread %d woke up on tick %lld instead of %lld",
+              t->id, t->bad_tick, t->bad_expected);
+    }
+  msg ("%d wakeups, all on time.", THREAD_CNT * ITERATIONS);
+
+  free (threads);
+}
+
+/* Sleeper thread. */
+static void
+sleeper (void *t_) 
+{
+  struct sleep_thread *t = t_;
+  int i;
+
+  /* Make sure we're at the beginning of a timer tick. */
+  timer_sleep (1);
+
+  for (i = 0; i < ITERATIONS; i++) 
+    {
+      int duration = 1 + (t->id * 7 + i * 31) % MAX_DURATION;
+      int64_t sleep_until = timer_ticks () + duration;
+      int64_t woke;
+
+      timer_sleep (sleep_until - timer_ticks ());
+      woke = timer_ticks ();
+      if (woke == sleep_until)
+        t->wakeups++;
+      else if (t->bad_tick < 0)
+        {
+          t->bad_tick = woke;
+          t->bad_expected = sleep_until;
+        }
+    }
+  sema_up (t->done);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(alarm-many) begin
+(alarm-many) Creating 100 threads to sleep 10 times each.
+(alarm-many) Sleep durations range from 1 to 150 ticks.
+(alarm-many) Every thread should wake up on the tick it asked for.
+(alarm-many) 1000 wakeups, all on time.
+(alarm-many) end
+EOF
+pass;
@@ -0,0 +1,75 @@
+/* Allocates and frees 10,000 blocks of kernel virtual pages, each
+   1 to 4 pages long, keeping up to 256 of them allocated at once
+   and freeing them in pseudo-random order, which splits and merges
+   the kernel's free ranges in every way.  Each block must be
+   allocated and no longer open once palloc returns it, and open
+   again once it is freed.  Prints the ticks the whole sequence
+   took, as a benchmark of the free range index. */
+
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+#include "devices/timer.h"
+
+#define BLOCK_CNT 10000         /* Number of blocks allocated. */
+#define LIVE_MAX 256            /* Most blocks allocated at once. */
+#define PAGES_MAX 4             /* Most pages per block. */
+
+/* An allocated block. */
+struct block
+  {
+    void *start;                /* First page. */
+    size_t page_cnt;            /* Number of pages. */
+  };
+
+static struct block live[LIVE_MAX];
+
+static void free_block (const struct block *);
+
+void
+test_palloc_bench (void) 
+{
+  size_t live_cnt = 0;
+  int64_t start;
+  int i;
+
+  msg ("Allocating and freeing %d kernel blocks.", BLOCK_CNT);
+  random_init (0);
+  start = timer_ticks ();
+  for (i = 0; i < BLOCK_CNT; i++) 
+    {
+      struct block *b;
+
+      /* Once the window is full, free a random block to make room. */
+      if (live_cnt == LIVE_MAX) 
+        {
+          b = &live[random_ulong () % live_cnt];
+          free_block (b);
+          *b = live[--live_cnt];
+        }
+
+      b = &live[live_cnt++];
+      b->page_cnt = random_ulong () % PAGES_MAX + 1;
+      b->start = palloc_get_multiple (PAL_PAGING, b->page_cnt);
+      if (b->start == NULL)
+        fail ("allocation %d of %zu pages failed", i, b->page_cnt);
+      if (palloc_block_open (b->start, b->page_cnt))
+        fail ("allocation %d is still open", i);
+    }
+  while (live_cnt > 0) 
+    free_block (&live[--live_cnt]);
+
+  printf ("palloc-bench: %d blocks in %lld ticks\n",
+          BLOCK_CNT, timer_elapsed (start));
+  msg ("All blocks were allocated and freed.");
+}
+
+/* Frees block B and checks that its pages are open again. */
+static void
+free_block (const struct block *b) 
+{
+  palloc_free_multiple (b->start, b->page_cnt);
+  if (!palloc_block_open (b->start, b->page_cnt))
+    fail ("freed block at %p is still allocated", b->start);
+}
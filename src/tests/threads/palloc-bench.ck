@@ -0,0 +1,26 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+# The test itself checks every block as it is allocated and freed.  The
+# tick count is a benchmark, so only insist that the whole sequence ran.
+my ($bench) = grep (/^palloc-bench: /, @output);
+fail "missing benchmark line in output" unless defined $bench;
+my ($blocks) = $bench =~ /^palloc-bench: (\d+) blocks in \d+ ticks$/
+  or fail "malformed benchmark line: $bench";
+fail "ran $blocks blocks, not 10000" if $blocks != 10000;
+@output = grep (!/^palloc-bench: /, @output);
+
+compare_output ("run", \@output, [<<'EOF']);
+(palloc-bench) begin
+(palloc-bench) Allocating and freeing 10000 kernel blocks.
+(palloc-bench) All blocks were allocated and freed.
+(palloc-bench) end
+EOF
+pass;
@@ -0,0 +1,113 @@
+/* Builds a chain of HOLDER_CNT lock holders, longer than
+   DONATION_DEPTH_MAX.  The main thread is holder 0 and holds lock
+   0; holder I, of priority PRI_DEFAULT + I, acquires lock I and
+   then blocks acquiring lock I - 1.  Each holder's donation is
+   passed along the chain to the DONATION_DEPTH_MAX holders before
+   it and no further.  A last donor of priority PRI_MAX then
+   blocks on the last lock: the DONATION_DEPTH_MAX holders nearest
+   it must get PRI_MAX, and the ones beyond must keep the priority
+   they had.  Releasing lock 0 must then let every holder and the
+   donor run to completion. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define HOLDER_CNT (DONATION_DEPTH_MAX + 4)
+
+/* A holder in the chain, other than the main thread. */
+struct holder
+  {
+    int priority;               /* Priority once it got its lock. */
+    bool finished;              /* Set once it released its locks. */
+  };
+
+static struct lock locks[HOLDER_CNT];
+static struct holder holders[HOLDER_CNT];
+static bool donor_finished;
+
+static thread_func holder_thread_func;
+static thread_func donor_thread_func;
+
+/* Returns the priority holder I has once the chain is built: the
+   last donor's if I is among the DONATION_DEPTH_MAX holders
+   before it, otherwise that of the furthest holder behind I that
+   still reaches it. */
+static int
+expected_priority (int i) 
+{
+  if (i >= HOLDER_CNT - DONATION_DEPTH_MAX)
+    return PRI_MAX;
+  return PRI_DEFAULT + i + DONATION_DEPTH_MAX;
+}
+
+void
+test_priority_donate_deep (void) 
+{
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  for (i = 0; i < HOLDER_CNT; i++)
+    lock_init (&locks[i]);
+  lock_acquire (&locks[0]);
+
+  for (i = 1; i < HOLDER_CNT; i++)
+    {
+      int nearest = i < DONATION_DEPTH_MAX ? i : DONATION_DEPTH_MAX;
+      char name[16];
+
+      snprintf (name, sizeof name, "holder %d", i);
+      thread_create (name, PRI_DEFAULT + i, holder_thread_func,
+                     (void *) i);
+      if (thread_get_priority () != PRI_DEFAULT + nearest)
+        fail ("Main thread should have priority %d after holder %d.  "
+              "Actual priority: %d.",
+              PRI_DEFAULT + nearest, i, thread_get_priority ());
+    }
+  msg ("Chain of %d holders built.", HOLDER_CNT);
+
+  thread_create ("donor", PRI_MAX, donor_thread_func, NULL);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       expected_priority (0), thread_get_priority ());
+
+  lock_release (&locks[0]);
+  for (i = 1; i < HOLDER_CNT; i++)
+    {
+      if (!holders[i].finished)
+        fail ("Holder %d should have finished.", i);
+      msg ("Holder %d should have had priority %d.  Actual priority: %d.",
+           i, expected_priority (i), holders[i].priority);
+    }
+  if (!donor_finished)
+    fail ("Donor should have finished.");
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+}
+
+static void
+holder_thread_func (void *i_) 
+{
+  int i = (int) i_;
+
+  lock_acquire (&locks[i]);
+  lock_acquire (&locks[i - 1]);
+  holders[i].priority = thread_get_priority ();
+  lock_release (&locks[i - 1]);
+  lock_release (&locks[i]);
+  holders[i].finished = true;
+}
+
+static void
+donor_thread_func (void *aux UNUSED) 
+{
+  lock_acquire (&locks[HOLDER_CNT - 1]);
+  lock_release (&locks[HOLDER_CNT - 1]);
+  donor_finished = true;
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-donate-deep) begin
+(priority-donate-deep) Chain of 12 holders built.
+(priority-donate-deep) Main thread should have priority 39.  Actual priority: 39.
+(priority-donate-deep) Holder 1 should have had priority 40.  Actual priority: 40.
+(priority-donate-deep) Holder 2 should have had priority 41.  Actual priority: 41.
+(priority-donate-deep) Holder 3 should have had priority 42.  Actual priority: 42.
+(priority-donate-deep) Holder 4 should have had priority 63.  Actual priority: 63.
+(priority-donate-deep) Holder 5 should have had priority 63.  Actual priority: 63.
+(priority-donate-deep) Holder 6 should have had priority 63.  Actual priority: 63.
+(priority-donate-deep) Holder 7 should have had priority 63.  Actual priority: 63.
+(priority-donate-deep) Holder 8 should have had priority 63.  Actual priority: 63.
+(priority-donate-deep) Holder 9 should have had priority 63.  Actual priority: 63.
+(priority-donate-deep) Holder 10 should have had priority 63.  Actual priority: 63.
+(priority-donate-deep) Holder 11 should have had priority 63.  Actual priority: 63.
+(priority-donate-deep) Main thread should have priority 31.  Actual priority: 31.
+(priority-donate-deep) end
+EOF
+pass;
@@ -0,0 +1,94 @@
+/* The main thread acquires LOCK_CNT locks, then creates one
+   thread per lock, each with at least the priority of the one
+   before, which blocks acquiring its lock and so donates its
+   priority to the main thread.  The main thread then releases
+   the locks from the last to the first.  Each release must let
+   exactly that lock's thread run to completion, and leave the
+   main thread with the priority of the highest priority thread
+   still waiting. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define LOCK_CNT 128
+
+/* A thread waiting for one of the main thread's locks. */
+struct donor
+  {
+    struct lock lock;           /* Lock held by the main thread. */
+    int priority;               /* Priority of the donor thread. */
+    bool finished;              /* Set once the donor got its lock. */
+  };
+
+/* Too large for the main thread's stack. */
+static struct donor donors[LOCK_CNT];
+
+static thread_func donor_thread_func;
+
+void
+test_priority_donate_wide (void) 
+{
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  for (i = 0; i < LOCK_CNT; i++)
+    {
+      struct donor *d = &donors[i];
+      lock_init (&d->lock);
+      lock_acquire (&d->lock);
+      d->priority = PRI_DEFAULT + 1
+                    + i * (PRI_MAX - PRI_DEFAULT - 1) / (LOCK_CNT - 1);
+      d->finished = false;
+    }
+  msg ("Main thread acquired %d locks.", LOCK_CNT);
+
+  for (i = 0; i < LOCK_CNT; i++)
+    {
+      char name[16];
+
+      snprintf (name, sizeof name, "donor %d", i);
+      thread_create (name, donors[i].priority, donor_thread_func, &donors[i]);
+      if (thread_get_priority () != donors[i].priority)
+        fail ("Main thread should have priority %d after donor %d.  "
+              "Actual priority: %d.",
+              donors[i].priority, i, thread_get_priority ());
+    }
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_MAX, thread_get_priority ());
+
+  for (i = LOCK_CNT - 1; i >= 0; i--)
+    {
+      int expected = i > 0 ? donors[i - 1].priority : PRI_DEFAULT;
+
+      lock_release (&donors[i].lock);
+      if (!donors[i].finished)
+        fail ("Donor %d should have finished.", i);
+      if (i > 0 && donors[i - 1].finished)
+        fail ("Donor %d finished out of order.", i - 1);
+      if (thread_get_priority () != expected)
+        fail ("Main thread should have priority %d after releasing "
+              "lock %d.  Actual priority: %d.",
+              expected, i, thread_get_priority ());
+    }
+  msg ("All %d donors finished in order.", LOCK_CNT);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+}
+
+static void
+donor_thread_func (void *donor_) 
+{
+  struct donor *d = donor_;
+
+  lock_acquire (&d->lock);
+  d->finished = true;
+  lock_release (&d->lock);
+}
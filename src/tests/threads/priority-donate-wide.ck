@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-donate-wide) begin
+(priority-donate-wide) Main thread acquired 128 locks.
+(priority-donate-wide) Main thread should have priority 63.  Actual priority: 63.
+(priority-donate-wide) All 128 donors finished in order.
+(priority-donate-wide) Main thread should have priority 31.  Actual priority: 31.
+(priority-donate-wide) end
+EOF
+pass;
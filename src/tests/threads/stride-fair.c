@@ -0,0 +1,118 @@
+/* Measures the proportional share of the stride scheduler.
+
+   Each test starts a number of threads, each holding a different
+   number of tickets, which spin for 30 seconds counting the timer
+   ticks during which they ran.  Each thread should receive a share
+   of the approximately 30 * 100 == 3000 ticks proportional to its
+   tickets.
+
+   The stride-fair-2 test runs 2 threads with 200 and 800 tickets,
+   which should receive 600 and 2,400 ticks, respectively.
+
+   The stride-fair-20 test runs 20 threads with 10, 20, ..., 200
+   tickets.
+
+   The stride-fair-200 test runs 200 threads with 25, 50, 75 and
+   100 tickets in turn.
+
+   (The expected counts are computed in stride.pm.) */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+static void test_stride_fair (int thread_cnt, int tickets_min,
+                              int tickets_step, int tickets_period);
+
+void
+test_stride_fair_2 (void) 
+{
+  test_stride_fair (2, 200, 600, 2);
+}
+
+void
+test_stride_fair_20 (void) 
+{
+  test_stride_fair (20, 10, 10, 20);
+}
+
+void
+test_stride_fair_200 (void) 
+{
+  test_stride_fair (200, 25, 25, 4);
+}
+
+#define MAX_THREAD_CNT 200
+
+struct thread_info 
+  {
+    int64_t start_time;
+    int tick_count;
+    int tickets;
+  };
+
+/* Too big for the stack with 200 threads. */
+static struct thread_info info[MAX_THREAD_CNT];
+
+static void load_thread (void *aux);
+
+/* Starts THREAD_CNT threads.  Thread I gets TICKETS_MIN plus
+   TICKETS_STEP times I modulo TICKETS_PERIOD tickets. */
+static void
+test_stride_fair (int thread_cnt, int tickets_min, int tickets_step,
+                  int tickets_period)
+{
+  int64_t start_time;
+  int i;
+
+  ASSERT (thread_stride);
+  ASSERT (thread_cnt <= MAX_THREAD_CNT);
+  ASSERT (tickets_min >= TICKETS_MIN);
+  ASSERT (tickets_min + tickets_step * (tickets_period - 1) <= TICKETS_MAX);
+
+  thread_set_tickets (TICKETS_MAX);
+
+  start_time = timer_ticks ();
+  msg ("Starting %d threads...", thread_cnt);
+  for (i = 0; i < thread_cnt; i++) 
+    {
+      struct thread_info *ti = &info[i];
+      char name[16];
+
+      ti->start_time = start_time;
+      ti->tick_count = 0;
+      ti->tickets = tickets_min + tickets_step * (i % tickets_period);
+
+      snprintf(name, sizeof name, "load %d", i);
+      thread_create (name, PRI_DEFAULT, load_thread, ti);
+    }
+  msg ("Starting threads took %"PRId64" ticks.", timer_elapsed (start_time));
+
+  msg ("Sleeping 40 seconds to let threads run, please wait...");
+  timer_sleep (40 * TIMER_FREQ);
+  
+  for (i = 0; i < thread_cnt; i++)
+    msg ("Thread %d received %d ticks.", i, info[i].tick_count);
+}
+
+static void
+load_thread (void *ti_) 
+{
+  struct thread_info *ti = ti_;
+  int64_t sleep_time = 5 * TIMER_FREQ;
+  int64_t spin_time = sleep_time + 30 * TIMER_FREQ;
+  int64_t last_time = 0;
+
+  thread_set_tickets (ti->tickets);
+  timer_sleep (sleep_time - timer_elapsed (ti->start_time));
+  while (timer_elapsed (ti->start_time) < spin_time) 
+    {
+      int64_t cur_time = timer_ticks ();
+      if (cur_time != last_time)
+        ti->tick_count++;
+      last_time = cur_time;
+    }
+}
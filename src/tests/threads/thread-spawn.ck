@@ -0,0 +1,32 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+# With the cache disabled, only pages left in it before the test can be
+# reused.  With it enabled, each thread exits before the next one is
+# created, so all but the odd thread preempted between waking the test
+# and exiting should hand its page on.
+my ($stats) = grep (/^thread-spawn: /, @output);
+fail "missing statistics line in output" unless defined $stats;
+my ($spawns, $uncached_hits, $cached_hits)
+  = $stats =~ /^thread-spawn: (\d+) spawns, uncached -?\d+ ticks (\d+) hits, cached -?\d+ ticks (\d+) hits$/
+  or fail "malformed statistics line: $stats";
+fail "only $cached_hits of $spawns threads reused a cached page"
+  if $cached_hits < $spawns / 2;
+fail "$uncached_hits threads reused a page with the cache disabled"
+  if $uncached_hits >= $cached_hits;
+@output = grep (!/^thread-spawn: /, @output);
+
+compare_output ("run", \@output, [<<'EOF']);
+(thread-spawn) begin
+(thread-spawn) Spawning 2000 threads without and then with the thread cache.
+(thread-spawn) All threads ran in both runs.
+(thread-spawn) end
+EOF
+pass;
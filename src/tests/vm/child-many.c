@@ -0,0 +1,42 @@
+/* Child process of page-many.
+   Maps the 64-page "many.dat" 782 times over, back to back, for
+   50,048 mapped pages, then checks one page of each mapping. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+
+const char *test_name = "child-many";
+
+#define FILE_PAGES 64
+#define MAP_CNT 782
+#define ACTUAL ((char *) 0x10000000)
+
+int
+main (void)
+{
+  int handle;
+  int i;
+
+  quiet = true;
+
+  handle = open ("many.dat");
+  if (handle < 2)
+    fail ("open \"many.dat\"");
+
+  for (i = 0; i < MAP_CNT; i++)
+    if (mmap (handle, ACTUAL + i * FILE_PAGES * 4096) == MAP_FAILED)
+      fail ("mmap %d of \"many.dat\"", i);
+
+  /* Each mapping has its own page read in, a different one for each
+     of the mappings in a row. */
+  for (i = 0; i < MAP_CNT; i++)
+    {
+      int p = i % FILE_PAGES;
+      char c = ACTUAL[(i * FILE_PAGES + p) * 4096];
+
+      if (c != p)
+        fail ("page %d of mapping %d starts with %d", p, i, c);
+    }
+
+  return 0x42;
+}
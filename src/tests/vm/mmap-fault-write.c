@@ -0,0 +1,45 @@
+/* Maps a file of several pages, faults each page in by reading
+   it, then writes to every page, unmaps the file, and reads the
+   file back using the read system call to verify that every
+   write reached it.  A page brought in by a fault, or mapped
+   ahead of one, must still be found dirty when written. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((char *) 0x10000000)
+#define PAGE_SIZE 4096
+#define PAGE_CNT 8
+
+void
+test_main (void)
+{
+  static char buf[PAGE_SIZE * PAGE_CNT];
+  int handle;
+  mapid_t map;
+  size_t i;
+
+  CHECK (create ("fault.dat", sizeof buf), "create \"fault.dat\"");
+  CHECK ((handle = open ("fault.dat")) > 1, "open \"fault.dat\"");
+  CHECK ((map = mmap (handle, ACTUAL)) != MAP_FAILED, "mmap \"fault.dat\"");
+
+  /* Fault every page in clean, then dirty it. */
+  for (i = 0; i < sizeof buf; i += PAGE_SIZE)
+    if (ACTUAL[i] != 0)
+      fail ("byte %zu of new file is not zero", i);
+  for (i = 0; i < sizeof buf; i++)
+    ACTUAL[i] = i % 251;
+  munmap (map);
+
+  /* Read back via read(). */
+  seek (handle, 0);
+  CHECK (read (handle, buf, sizeof buf) == (int) sizeof buf,
+         "read \"fault.dat\"");
+  for (i = 0; i < sizeof buf; i++)
+    if (buf[i] != (char) (i % 251))
+      fail ("byte %zu of file is %d, not %d", i, buf[i], (int) (i % 251));
+  msg ("file holds data written through mapping");
+  close (handle);
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-fault-write) begin
+(mmap-fault-write) create "fault.dat"
+(mmap-fault-write) open "fault.dat"
+(mmap-fault-write) mmap "fault.dat"
+(mmap-fault-write) read "fault.dat"
+(mmap-fault-write) file holds data written through mapping
+(mmap-fault-write) end
+EOF
+pass;
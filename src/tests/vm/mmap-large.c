@@ -0,0 +1,76 @@
+/* Maps 8 MB of zeroed memory with MAP_LARGE, which the kernel
+   may back with 4 MB pages, and a few more pages after it without,
+   checks that every page starts out zeroed, writes each page's
+   number into it and reads them all back.  Then unmaps the 8 MB
+   and maps it again, which must give zeroed memory once more, and
+   checks that misaligned and overlapping mappings fail. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((char *) 0x10000000)
+#define LARGE_SIZE (8 * 1024 * 1024)
+#define SMALL_SIZE (3 * 4096 + 100)
+#define PAGE_SIZE 4096
+
+/* Checks that each page of the SIZE bytes at START holds zeroes,
+   then writes its page number into its first word. */
+static void
+check_and_fill (char *start, unsigned size) 
+{
+  unsigned ofs;
+
+  for (ofs = 0; ofs < size; ofs += PAGE_SIZE)
+    {
+      int *p = (int *) (start + ofs);
+      if (p[0] != 0 || p[PAGE_SIZE / sizeof *p - 1] != 0)
+        fail ("page at %p is not zeroed", p);
+      p[0] = ofs / PAGE_SIZE;
+    }
+}
+
+/* Checks that each page of the SIZE bytes at START holds its page
+   number, as written by check_and_fill(). */
+static void
+check_filled (char *start, unsigned size) 
+{
+  unsigned ofs;
+
+  for (ofs = 0; ofs < size; ofs += PAGE_SIZE)
+    if (*(int *) (start + ofs) != (int) (ofs / PAGE_SIZE))
+      fail ("page at %p holds %d", start + ofs, *(int *) (start + ofs));
+}
+
+void
+test_main (void)
+{
+  char *small = ACTUAL + LARGE_SIZE;
+  mapid_t large_map, small_map;
+
+  CHECK ((large_map = mmap_anon (ACTUAL, LARGE_SIZE, MAP_LARGE))
+         != MAP_FAILED, "mmap_anon 8 MB with MAP_LARGE");
+  CHECK ((small_map = mmap_anon (small, SMALL_SIZE, 0)) != MAP_FAILED,
+         "mmap_anon 4 pages");
+
+  msg ("fill and check pages");
+  check_and_fill (ACTUAL, LARGE_SIZE);
+  check_and_fill (small, SMALL_SIZE);
+  check_filled (ACTUAL, LARGE_SIZE);
+  check_filled (small, SMALL_SIZE);
+
+  munmap (large_map);
+  CHECK ((large_map = mmap_anon (ACTUAL, LARGE_SIZE, MAP_LARGE))
+         != MAP_FAILED, "mmap_anon 8 MB with MAP_LARGE again");
+  msg ("check pages are zeroed again");
+  check_and_fill (ACTUAL, LARGE_SIZE);
+  check_filled (small, SMALL_SIZE);
+
+  CHECK (mmap_anon (ACTUAL + 2 * LARGE_SIZE + 100, PAGE_SIZE, 0) == MAP_FAILED,
+         "try to mmap_anon at a misaligned address");
+  CHECK (mmap_anon (small - PAGE_SIZE, 2 * PAGE_SIZE, MAP_LARGE)
+         == MAP_FAILED, "try to mmap_anon over mapped memory");
+
+  munmap (large_map);
+  munmap (small_map);
+}
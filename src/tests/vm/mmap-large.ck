@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-large) begin
+(mmap-large) mmap_anon 8 MB with MAP_LARGE
+(mmap-large) mmap_anon 4 pages
+(mmap-large) fill and check pages
+(mmap-large) mmap_anon 8 MB with MAP_LARGE again
+(mmap-large) check pages are zeroed again
+(mmap-large) try to mmap_anon at a misaligned address
+(mmap-large) try to mmap_anon over mapped memory
+(mmap-large) end
+EOF
+pass;
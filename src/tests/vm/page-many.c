@@ -0,0 +1,39 @@
+/* Creates a 64-page file, then runs 4 child-many processes at
+   once, each of which maps it about 50,000 pages' worth of times,
+   so that over 200,000 pages are mapped across the processes. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 4
+#define FILE_PAGES 64
+
+static char page[4096];
+
+void
+test_main (void)
+{
+  pid_t children[CHILD_CNT];
+  int handle;
+  int i;
+
+  /* Start each page of the file with its page number. */
+  CHECK (create ("many.dat", sizeof page * FILE_PAGES), "create \"many.dat\"");
+  CHECK ((handle = open ("many.dat")) > 1, "open \"many.dat\"");
+  for (i = 0; i < FILE_PAGES; i++)
+    {
+      page[0] = i;
+      if (write (handle, page, sizeof page) != (int) sizeof page)
+        fail ("write of page %d failed", i);
+    }
+  msg ("write \"many.dat\"");
+  close (handle);
+
+  for (i = 0; i < CHILD_CNT; i++) 
+    CHECK ((children[i] = exec ("child-many")) != -1,
+           "exec \"child-many\"");
+
+  for (i = 0; i < CHILD_CNT; i++) 
+    CHECK (wait (children[i]) == 0x42, "wait for child %d", i);
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-many) begin
+(page-many) create "many.dat"
+(page-many) open "many.dat"
+(page-many) write "many.dat"
+(page-many) exec "child-many"
+(page-many) exec "child-many"
+(page-many) exec "child-many"
+(page-many) exec "child-many"
+(page-many) wait for child 0
+(page-many) wait for child 1
+(page-many) wait for child 2
+(page-many) wait for child 3
+(page-many) end
+EOF
+pass;
@@ -128,19 +128,17 @@ void * fmalloc(size_t size) {
         /* Put page into frame and install */
         struct frame *f = get_frame_addr(false);
         printf("HI, from fmalloc");
-        pagedir_set_page_kernel(init_page_dir, page, f->faddr, true);
+        pagedir_set_page_kernel(init_page_dir, page, falloc_frame_addr(f), true);
         uint32_t *pte = lookup_page(init_page_dir, page, false);
         *pte |= PTE_P | PTE_PIN;
-        /* Set frame entries */
-        f->pte = pte;
-        f->sup_entry = NULL;
-        f->owner = NULL;
         /* Now set up page_entry for page */
         a = page;
         a->pg_ent.vaddr = page;
         a->pg_ent.source = FRAME_PAGE;
-        a->pg_ent.data = f;
-        list_insert_ordered(init_page_dir_sup, &(a->pg_ent.elem), palloc_page_less, NULL);
+        a->pg_ent.shared = false;
+        palloc_page_insert(&(a->pg_ent), NULL);
+        /* Set frame entries */
+        f->sup_entry = &(a->pg_ent);
         
         /* Initialize arena and add its blocks to the free list. */
         a->magic = ARENA_MAGIC;
@@ -50,7 +50,6 @@
 
 /*! Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
-struct list *init_page_dir_sup;
 
 #ifdef FILESYS
 /* -f: Format the file system? */
@@ -104,8 +103,7 @@ int main(void) {
            init_ram_pages * PGSIZE / 1024);
 
     /* Initialize memory system. */
-    falloc_init(user_page_limit);;
-    palloc_init();
+    falloc_init(user_page_limit);
     paging_init();
     malloc_init();
 
@@ -137,8 +135,11 @@ int main(void) {
     filesys_init(format_filesys);
 #endif
 
-    /* Initialize the swap allocator. */
+    /* Initialize the swap allocator, start paging out, and start zeroing
+       free frames. */
     swalloc_init();
+    falloc_start_pageout();
+    falloc_start_zeroer();
 
     printf("Boot complete.\n");
 
@@ -225,20 +226,37 @@ static char ** parse_options(char **argv) {
 #ifdef VM
         else if (!strcmp(name, "-swap"))
             swap_bdev_name = value;
+        else if (!strcmp(name, "-evict"))
+            falloc_set_policy(value);
+        else if (!strcmp(name, "-pageout"))
+            falloc_set_watermarks(value);
 #endif
 #endif
         else if (!strcmp(name, "-rs"))
             random_init(atoi(value));
         else if (!strcmp(name, "-mlfqs"))
             thread_mlfqs = true;
+        else if (!strcmp(name, "-stride"))
+            thread_stride = true;
+        else if (!strcmp(name, "-tickless"))
+            timer_tickless = true;
+        else if (!strcmp(name, "-schedstat"))
+            thread_schedstat = true;
+        else if (!strcmp(name, "-tcache"))
+            thread_cache_max = atoi(value);
 #ifdef USERPROG
         else if (!strcmp(name, "-ul"))
             user_page_limit = atoi(value);
+        else if (!strcmp(name, "-stack"))
+            process_set_stack_pages(value);
 #endif
         else
             PANIC("unknown option `%s' (use -h for help)", name);
     }
 
+    if (thread_mlfqs && thread_stride)
+        PANIC("-mlfqs and -stride cannot be used together");
+
     /* Initialize the random number generator based on the system
        time.  This has no effect if an "-rs" option was specified.
 
@@ -344,12 +362,19 @@ static void usage(void) {
            "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
 #ifdef VM
            "  -swap=BDEV         Use BDEV for swap instead of default.\n"
+           "  -evict=POLICY      Evict frames by clock, aging or wsclock.\n"
+           "  -pageout=LOW,HIGH  Keep LOW to HIGH user frames free (0=off).\n"
 #endif
 #endif
            "  -rs=SEED           Set random number seed to SEED.\n"
            "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+           "  -stride            Use stride (proportional-share) scheduler.\n"
+           "  -tickless          Stop the timer tick while the CPU is idle.\n"
+           "  -schedstat         Print scheduler latency histograms at shutdown.\n"
+           "  -tcache=COUNT      Keep up to COUNT exited threads' pages for reuse.\n"
 #ifdef USERPROG
            "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+           "  -stack=COUNT       Reserve COUNT pages for each user stack.\n"
 #endif
           );
     shutdown_power_off();
@@ -27,17 +27,76 @@
 #include "threads/vaddr.h"
 #include "threads/pte.h"
 #include "vm/falloc.h"
+#include "vm/swalloc.h"
+#include "vm/vspace.h"
 #include "userprog/pagedir.h"
 #include "userprog/syscall.h"
 
+/*! Supplemental page table.  Holds every page entry, hashed by owner and
+    page number, where paging data has no owner.  Each of its power of 2
+    number of buckets chains its entries through their hash_next members.
+    The buckets are carved out of pinned memory by falloc_init(), as the
+    table is searched while handling page faults and so must never fault
+    itself. */
+static struct page_entry **page_table;
+static size_t page_table_cnt;
+
+/*! Free pages of kernel virtual memory, shared by every process. */
+static struct vspace kernel_vspace;
+
 static bool palloc_block_valid(void *start_addr, size_t block_size);
+static struct vspace *palloc_vspace(const void *vaddr);
+static struct page_entry **page_bucket(struct thread *owner,
+                                       const void *vaddr);
+
+/*! Initializes the page allocator, using the BUCKET_CNT buckets at BUCKETS
+    for the supplemental page table.  The kernel address space is
+    the KERNEL_PAGES pages from PHYS_BASE that falloc_init() made page
+    tables for.  The BOOT_PAGE_CNT page entries at BOOT_PAGES, of the
+    paging data already mapped by falloc_init(), are entered into the table
+    and their pages taken out of the free kernel address space. */
+void palloc_init(struct page_entry **buckets, size_t bucket_cnt,
+                 size_t kernel_pages, struct page_entry *boot_pages,
+                 size_t boot_page_cnt)
+{
+    size_t i;
+
+    ASSERT(bucket_cnt > 0 && (bucket_cnt & (bucket_cnt - 1)) == 0);
+    page_table = buckets;
+    page_table_cnt = bucket_cnt;
+    for (i = 0; i < bucket_cnt; i++) {
+        page_table[i] = NULL;
+    }
+    if (!vspace_create(&kernel_vspace, pg_no(PHYS_BASE), kernel_pages)) {
+        PANIC("palloc_init: out of address ranges");
+    }
+    for (i = 0; i < boot_page_cnt; i++) {
+        palloc_page_insert(&boot_pages[i], NULL);
+        vspace_take(&kernel_vspace, pg_no(boot_pages[i].vaddr), 1);
+    }
+}
 
-/*! Initializes the page allocator.  At most USER_PAGE_LIMIT
-    pages are put into the user pool. */
-void palloc_init(void)
+/*! Enters PAGE into the supplemental page table as a page of OWNER, or as
+    paging data if OWNER is NULL. */
+void palloc_page_insert(struct page_entry *page, struct thread *owner)
 {
-    /* TODO: Does nothing for now. */
+    struct page_entry **bucket = page_bucket(owner, page->vaddr);
 
+    page->owner = owner;
+    page->hash_next = *bucket;
+    *bucket = page;
+}
+
+/*! Removes PAGE from the supplemental page table. */
+void palloc_page_remove(struct page_entry *page)
+{
+    struct page_entry **p = page_bucket(page->owner, page->vaddr);
+
+    while (*p != page) {
+        ASSERT(*p != NULL);
+        p = &((*p)->hash_next);
+    }
+    *p = page->hash_next;
 }
 
 /*! Obtains and returns a group of PAGE_CNT contiguous free pages starting at
@@ -46,9 +105,12 @@ void palloc_init(void)
     are filled with zeros.  If PAL_PIN is set in FLGAS, then the pages are
     pinned.  If too few pages are available, returns a null pointer, unless 
     PAL_ASSERT is set in FLAGS, in which case the kernel panics.  If LOAD_TYPE
-    is ZERO_PAGE, then the page data pointer is set to NULL, otherwise it is set
-    to the passed pointer DATA.  If LOAD_TYPE is FILE_PAGE, the page's file
-    offset is set to F_OFS. */
+    is FILE_PAGE, the pages are read from the file DATA starting at F_OFS,
+    which must be page aligned, and if PAL_MMAP is set the page is written back to
+    the file when it is dirty.  If PAL_SHARE is set as well, the pages are
+    read-only and shared with every process mapping the same file pages.  If
+    PAL_LARGE is set, no page table entries are made, as the pages are to be
+    mapped as one 4 MB page. */
 void *palloc_make_multiple_addr(void * start_addr,
                                 enum palloc_flags flags,
                                 size_t page_cnt,
@@ -56,13 +118,12 @@ void *palloc_make_multiple_addr(void * start_addr,
                                 void *data,
                                 void *f_ofs) {
 
-    struct list *alloc_page_list;
+    struct thread *owner;
     uint32_t i;
     struct thread *t = thread_current();
     uint32_t *pagedir;
     uint32_t *pte;
     void *vaddr;
-    void *curr_f_ofs = f_ofs;
 
     /* Page data should not be in a frame. */
     if (load_type == FRAME_PAGE) {
@@ -70,17 +131,21 @@ void *palloc_make_multiple_addr(void * start_addr,
         ASSERT(false);
     }
 
-    /* Use to correct pool based on whether it is paging data or not. */
-    if (flags & PAL_PAGING) {
-        alloc_page_list = init_page_dir_sup;
-        pagedir = init_page_dir;
-    } else {
-        alloc_page_list = &(t->page_entries);
+    /* User pages belong to the process.  Kernel pages go in the kernel page
+       tables that every page directory shares, and belong to no thread, so
+       that any thread may fault them in or free them. */
+    if (flags & PAL_USER) {
+        owner = t;
         pagedir = t->pagedir;
+    } else {
+        owner = NULL;
+        pagedir = init_page_dir;
     }
 
-    /* If block at specified address is not open, return NULL. */
-    if (!palloc_block_open(start_addr, page_cnt)) {
+    /* If block at specified address is not open, return NULL.  Otherwise
+       take it out of the free address space. */
+    if (!palloc_block_valid(start_addr, page_cnt) ||
+        !vspace_take(palloc_vspace(start_addr), pg_no(start_addr), page_cnt)) {
         if (flags & PAL_ASSERT) {
             PANIC("palloc: out of pages");
         }
@@ -96,31 +161,35 @@ void *palloc_make_multiple_addr(void * start_addr,
         ASSERT (page_i != NULL);
 
         /* Get the virtual address for the page. */
-        vaddr = (uint8_t *) (start_addr + (i * PGSIZE)) + PGSIZE * 1000;
+        vaddr = (uint8_t *) start_addr + i * PGSIZE;
 
         /* Initialize the page. */
         page_i->vaddr = vaddr;
         page_i->source = load_type;
 
-        if (load_type == ZERO_PAGE) {
-            page_i->data = NULL;
-        }
-        else {
-            page_i->data = data;
-        }
-
         if (load_type == FILE_PAGE) {
-            /* Get the file offset. */
-            curr_f_ofs += PGSIZE;
-            page_i->f_ofs = curr_f_ofs;
+            /* Get the file offset, and remember the file so that clean
+               pages can be dropped and read back in. */
+            ASSERT(pg_ofs(f_ofs) == 0);
+            page_i->f_page = pg_no(f_ofs) + i;
+            page_i->file = data;
         }
         else {
-            page_i->f_ofs = NULL;
+            page_i->f_page = 0;
+            page_i->file = NULL;
         }
+        page_i->swap = NULL;
+        page_i->mmap = (flags & PAL_MMAP) != 0;
+        page_i->shared = false;
         
-        /* Add to list of allocated pages in order by address. */
-        list_insert_ordered(alloc_page_list, &(page_i->elem), 
-                            palloc_page_less, NULL);
+        /* Add to the supplemental page table. */
+        palloc_page_insert(page_i, owner);
+
+        /* The pages of a 4 MB page are mapped together by one PDE, by
+           falloc_get_large(). */
+        if (flags & PAL_LARGE) {
+            continue;
+        }
 
         if (flags & PAL_USER) {
             pagedir_set_page(pagedir, vaddr, 0, !(flags & PAL_READO));
@@ -139,6 +208,11 @@ void *palloc_make_multiple_addr(void * start_addr,
         if (flags & PAL_PIN) {
            *pte = *pte | PTE_PIN;
         }
+
+        /* Share the page, mapping it now if another process has it in. */
+        if ((flags & PAL_SHARE) && load_type == FILE_PAGE) {
+            falloc_share_page(page_i);
+        }
         
     }
     return start_addr;
@@ -149,9 +223,8 @@ void *palloc_make_multiple_addr(void * start_addr,
     pool.  If PAL_ZERO is set in FLAGS, then the page is filled with zeros.
     If PAL_PIN is set in FLGAS, then the page is pinned.  If too few pages are
     available, returns a null pointer, unless PAL_ASSERT is set in FLAGS, in
-    which case the kernel panics.  If LOAD_TYPE is ZERO_PAGE, then the page data
-    pointer is set to NULL, otherwise it is set to the passed pointer DATA.  If 
-    LOAD_TYPE is FILE_PAGE, the page's file offset is set to F_OFS. */
+    which case the kernel panics.  If LOAD_TYPE is FILE_PAGE, the page is read
+    from the file DATA at F_OFS, which must be page aligned. */
 void *palloc_make_page_addr(void * start_addr, enum palloc_flags flags,
                             enum page_load load_type, void *data, void *f_ofs) {
 
@@ -177,9 +250,8 @@ void *palloc_get_multiple(enum palloc_flags flags, size_t page_cnt) {
     pool.  If PAL_ZERO is set in FLAGS, then the pages are filled with zeros.
     If PAL_PIN is set in FLGAS, then the pages are pinned.  If too few pages are
     available, returns a null pointer, unless PAL_ASSERT is set in FLAGS, in
-    which case the kernel panics.  If LOAD_TYPE is ZERO_PAGE, then the page data
-    pointer is set to NULL, otherwise it is set to the passed pointer DATA.  If
-    LOAD_TYPE is FILE_PAGE, the page's file offset is set to F_OFS. */
+    which case the kernel panics.  If LOAD_TYPE is FILE_PAGE, the pages are read
+    from the file DATA starting at F_OFS, which must be page aligned. */
 void *_palloc_get_multiple(enum palloc_flags flags, size_t page_cnt,
                             enum page_load load_type, void *data, void *f_ofs) {
     void *start_addr;
@@ -213,15 +285,9 @@ void *_palloc_get_page(enum palloc_flags flags, enum page_load load_type,
 /*! Frees the PAGE_CNT pages starting at PAGES. */
 /* TODO: Deletetion from kernel pagedir affects all processes. */
 void palloc_free_multiple(void *pages, size_t page_cnt) {
-    uint32_t i = 0;
-    void *vaddr = pages;
-    struct list *alloc_page_list;
-    bool user_space;
-    struct page_entry *start_page;
-    struct list_elem *e;
-    struct thread *t = thread_current();
-    bool start_page_found = false;
-    bool paging_list = false;
+    uint32_t i;
+    uint8_t *vaddr = pages;
+    struct page_entry *page_e;
 
     /* Make sure the block to free is valid. */
     if(!palloc_block_valid(pages, page_cnt)) {
@@ -229,78 +295,48 @@ void palloc_free_multiple(void *pages, size_t page_cnt) {
         kill_current_thread(1);
     }
 
-    /* Check if from user or kernel space. */
-    if (is_user_vaddr(pages)) {
-        user_space = true;
-    }
-    else {
-        user_space = false;
-    }
-
-    /* Look in the process list for the page first. */
-    alloc_page_list = &(t->page_entries);
-
-    while (!start_page_found) {
-
-        /* Find the starting address in the supplemental page table. */
-        for (e = list_begin(alloc_page_list); e != list_end(alloc_page_list);
-            e = list_next(e))
-        {
-            start_page = list_entry(e, struct page_entry, elem);
-
-            /* If reached starting address, can start freeing. */
-            if (start_page->vaddr == pages) {
-                start_page_found = true;
-                break;
-            }
-            /* If reached the end of paging list, page was not allocated, kill process. */
-            else if (list_next(e) == list_end(alloc_page_list) && paging_list) {
-                /* Kill process. */
-                kill_current_thread(1);
-            }
-        }
-
-        /* Move on to paging list if not in process list. */
-        if (!start_page_found) {
-            paging_list = true;
-            alloc_page_list = init_page_dir_sup;
-        }
-    }
-
     /* Go through all the pages in the block, freeing them. */
-    for (e = &(start_page->elem), i = 0;
-        e != list_end(alloc_page_list), i < page_cnt;
-        e = list_next(e), i++)
-    {
+    for (i = 0; i < page_cnt; i++, vaddr += PGSIZE) {
 
-        struct page_entry *page_e = list_entry(e, struct page_entry, elem);
+        page_e = palloc_addr_to_page_entry(vaddr);
 
         /* If an unallocated page is in the block, can't free. */
-        if (page_e->vaddr != vaddr) {
+        if (page_e == NULL) {
 
             /* TODO: Kill the process if user. */
-            if (user_space) {
+            if (is_user_vaddr(pages)) {
                 kill_current_thread(1);
             }
             /* TODO: Kernel panic if kernel. */
             else {
                 PANIC("palloc_free: unallocated page in block to free");
-
             }
         }
-        /* Otherwise, free the page. */
-        else {
 
-            /* Remove page from allocated list. */
-            list_remove(&(page_e->elem));
+        /* Stop sharing a shared page, unmapping it, or else release the
+           swap slot of a page that was evicted or cleaned. */
+        if (page_e->shared) {
+            falloc_unshare_page(page_e);
+        }
+        else if (page_e->swap != NULL) {
+            swalloc_free_swap(page_e->swap);
+        }
 
-            /* Free the supplemental page entry. */
-            free_page_entry(page_e);
+        /* Release the frame of a kernel page.  A process's frames are
+           released by process_exit() and mmap_release() instead. */
+        if (!is_user_vaddr(vaddr)) {
+            falloc_free_page(page_e);
         }
-        /* Go to the next page. */
-        vaddr += PGSIZE;
-    }
 
+        /* Remove page from the supplemental page table. */
+        palloc_page_remove(page_e);
+
+        /* Free the supplemental page entry and its address.  If no range
+           is left to hold the address, it stays used: only address space
+           is lost, until the process exits. */
+        free_page_entry(page_e);
+        vspace_give(palloc_vspace(vaddr), pg_no(vaddr), 1);
+    }
 }
 
 /*! Frees the page at PAGE. */
@@ -308,258 +344,40 @@ void palloc_free_page(void *page) {
     palloc_free_multiple(page, 1);
 }
 
-/*! A comparison of page entries based on virtual address for list elements */
-bool palloc_page_less(const struct list_elem *A,
-                             const struct list_elem *B,
-                             void* aux UNUSED) {
-
-    uint8_t *vaddrA = list_entry(A, struct page_entry, elem)->vaddr;
-    uint8_t *vaddrB = list_entry(B, struct page_entry, elem)->vaddr;
-
-    return vaddrA < vaddrB;
-}
-
-/*! Returns true if the block of size BLOCK_SIZE starting at virtual address
-    VADDR is open.  This list of allocated blocks to check must be passed via
-    ALLOC_LIST, and E is updated to the list_elem where the seach for an open
-    block finished. */
-bool palloc_block_open_list(void* vaddr, struct list *alloc_list,
-                            struct list_elem *e, size_t block_size) {
-    struct page_entry *curr_alloc_page;
-    struct page_entry *next_alloc_page;
-    struct list_elem *prev_elem;
-    struct list_elem *next_e;
-    void *end_addr;
-
-    /* If at the list end, block open if it is valid. */
-    if (e == list_end(alloc_list)) {
-        return palloc_block_valid(vaddr, block_size);
-    }
-
-    /* Get the address of page after end of proposed block. */
-    end_addr = vaddr + (block_size*PGSIZE);
-
-    next_alloc_page = list_entry(e, struct page_entry, elem);
-
-    /* If next allocated block is after end address, and block is valid, it is open. */
-    return (bool) (end_addr <= next_alloc_page->vaddr && palloc_block_valid(vaddr, block_size));
-
-}
-
-// TODO: might want to change it to get the one after
-/*! Starting at CURR_ELEM in list ALLOC_LIST, finds and returns the list_elem of
-    the allocated block at or just after the passed virtual address VADDR. */
-struct list_elem *palloc_alloc_elem_after_addr(void *vaddr,
-                                                struct list *alloc_list,
-                                                struct list_elem *curr_elem) {
-
-    struct list_elem *e;
-    struct page_entry *curr_page;
-    ASSERT(!list_empty(alloc_list));
-    ASSERT(curr_elem != list_end(alloc_list));
-    /* Search through list for the specified address. */
-    for (e = curr_elem; e != list_end(alloc_list); e = list_next(e)) {
-
-        curr_page = list_entry(e, struct page_entry, elem);
-
-        /* Once allocated page past the given address found, return it. */
-        if (((void *) curr_page->vaddr) >= vaddr) {
-            return e;
-        }
-    }
-
-    return list_end(alloc_list);
-}
-
 /*! Returns the address of an open block of size BLOCK_SIZE in the space
-    specified by USER_SPACE. */
+    specified by USER_SPACE, or NULL if there is none.  User blocks are
+    placed first fit, keeping a process's pages low and together.  Kernel
+    blocks are placed best fit, so that the one shared kernel space keeps
+    its long runs for large blocks.  User blocks never start at page 0, so
+    that null pointers fault. */
 void* palloc_get_open_addr(bool user_space, size_t block_size) {
+    uintptr_t page;
+    bool found;
 
-    bool block_found = false;
-    struct list *proc_list;
-    struct list *paging_list = init_page_dir_sup;
-    struct list_elem *proc_elem;
-    struct list_elem *paging_elem;
-    struct page_entry *proc_page;
-    struct page_entry *paging_page;
-    struct page_entry *next_proc_page;
-    struct page_entry *next_paging_page;
-    struct thread *t = thread_current();
-    uint32_t alloc_size = block_size * PGSIZE;
-    void *curr_addr;
-    void *start_addr;
-    bool proc_page_open = false;
-    bool paging_page_open = false;
-    int last_page_index;
-    uint32_t i;
-
-    /* Look in the process list for the starting page first. */
-    proc_list = &(t->page_entries);
-
-    /* If requesting kernel space, get to kernel space first. */
-    if (!user_space) {
-
-        if (!list_empty(proc_list)) {
-            proc_elem = palloc_alloc_elem_after_addr(PHYS_BASE, proc_list, list_begin(proc_list));
-            /* Check if there is an open block at start of kernel space. */
-            proc_page_open = palloc_block_open_list(PHYS_BASE, proc_list, proc_elem, block_size);
-        }
-        else {
-            proc_page_open = palloc_block_valid(PHYS_BASE, block_size);
-        }
-
-        if (!list_empty(paging_list)) {
-            paging_elem = palloc_alloc_elem_after_addr(PHYS_BASE, paging_list, list_begin(paging_list));
-            /* Check if there is an open block at start of kernel space. */
-            paging_page_open = palloc_block_open_list(PHYS_BASE, paging_list, paging_elem, block_size);
-        }
-        else {
-            paging_page_open = palloc_block_valid(PHYS_BASE, block_size);
-        }
-
-        /* If open in both lists, valid address. */
-        if (proc_page_open && paging_page_open) {
-            return (void *) PHYS_BASE;
-        }
-        else {
-            proc_page_open = false;
-            paging_page_open = false;
-            start_addr = PHYS_BASE;
-            last_page_index = NUM_PAGES;
-        }
-
+    if (user_space) {
+        found = vspace_first_fit(&(thread_current()->vspace), block_size,
+                                 &page);
     }
     else {
-
-        if (!list_empty(proc_list)) {
-            proc_elem = palloc_alloc_elem_after_addr((void *) PGSIZE, proc_list, list_begin(proc_list));
-            /* Check if there is an open block at start of user space. */
-            proc_page_open = palloc_block_open_list((void *) PGSIZE, proc_list, proc_elem, block_size);
-        }
-        else {
-            proc_page_open = palloc_block_valid(PHYS_BASE, block_size);
-        }
-
-        /* If open in both lists, valid address. */
-        if (proc_page_open) {
-            return (void *) PGSIZE;
-        }
-        else {
-            proc_page_open = false;
-            paging_page_open = false;
-            start_addr = (void *) PGSIZE;
-            last_page_index = ((uint32_t) PHYS_BASE)/PGSIZE;
-        }
-    }
-
-    /* Search address space for an open block. */
-    for (i = (((uint32_t) start_addr)/PGSIZE) + 1; i < last_page_index; i++) {
-
-        curr_addr = (void *) (i * PGSIZE);
-        if (!list_empty(proc_list)) {
-            proc_elem = palloc_alloc_elem_after_addr(curr_addr, proc_list, proc_elem);
-            proc_page_open = palloc_block_open_list(curr_addr, proc_list, proc_elem, block_size);
-
-        }
-        else {
-            /* TODO: Might want to make a call to check if valid. */
-            proc_page_open = true;
-        }
-        /* If in kernel space need, to check that the block is open in both
-           lists. */
-        if (!user_space) {
-
-            if (!list_empty(paging_list)) {
-                paging_elem = palloc_alloc_elem_after_addr(curr_addr, paging_list, paging_elem);
-                paging_page_open = palloc_block_open_list(curr_addr, paging_list, paging_elem, block_size);
-            }
-            else {
-                /* TODO: Might want to make a call to check if valid. */
-                paging_page_open = true;
-            }
-
-            /* If free in both lists, then must be free. */
-            if (paging_page_open && proc_page_open) {
-                ASSERT(curr_addr >= (void *) PHYS_BASE);
-                return curr_addr;
-            }
-        }
-        else {
-            /* If in user space, and free in process list, must be free. */
-            if (proc_page_open) {
-                ASSERT(curr_addr >= (void *) PGSIZE);
-                return curr_addr;
-            }
-        }
+        found = vspace_best_fit(&kernel_vspace, block_size, &page);
     }
 
     /* If no open block could be found, return NULL. */
-    return NULL;
+    return found ? (void *) (page << PGBITS) : NULL;
 }
 
 /*! Returns true if the block of size block_size starting at start_addr is
     unallocated (open), and false otherwise. */
 bool palloc_block_open(void *start_addr, size_t block_size) {
-    struct list *alloc_page_list;
-    struct thread *t = thread_current();
-    void *end_addr;
-    struct list_elem *e;
-    struct list_elem *next_page;
-    struct page_entry *start_page;
-    bool page_found = false;
-    bool paging_list = false;
-
-    /* Calculate ending address of the block. */
-    end_addr = start_addr + (block_size*PGSIZE - 1);
-
     /* If the address overflowed, or entire block is not in the same space, the
        block is not open. */
     if (!palloc_block_valid(start_addr, block_size)) {
         return false;
     }
-    /* Look in the process list for the starting page first. */
-    alloc_page_list = &(t->page_entries);
-
-    while (!page_found) {
-
-        /* Find the starting address in the supplemental page table. */
-        for (e = list_begin(alloc_page_list); e != list_end(alloc_page_list);
-            e = list_next(e))
-        {
-            start_page = list_entry(e, struct page_entry, elem);
-
-            /* If a match is found, it is allocated and not open. */
-            if (((void *) start_page->vaddr) == start_addr) {
-                return false;
-            }
-            /* If end of paging list, no more allocated pages, block open. */
-            else if (list_next(e) == list_end(alloc_page_list) && paging_list) {
-                return true;
-            }
-            /* If reached starting address, can check unallocated until end addr */
-            else if (((void *) start_page->vaddr) > start_addr) {
-                /* Get the next allocated page. */
-                next_page = start_page; // DEBUG: should this be next or current???
-                page_found = true;
-                break;
-            }
-        }
-
-        /* Move on to paging list if not in process list. */
-        if (!page_found) {
-            paging_list = true;
-            alloc_page_list = init_page_dir_sup;
-        }
-    }
 
-    /* If the next alloc page is after ending address, block is open. */
-    if (((void *) list_entry(next_page, struct page_entry, elem)->vaddr) > end_addr) {
-        return true;
-    }
-    /* Otherwise, the block is not open. */
-    else {
-        return false;
-    }
+    /* The block is open if all of its pages are free. */
+    return vspace_is_free(palloc_vspace(start_addr), pg_no(start_addr),
+                          block_size);
 }
 
 /*! Returns true if the block of size BLOCK_SIZE starting at address START_ADDR
@@ -579,43 +397,40 @@ static bool palloc_block_valid(void *start_addr, size_t block_size) {
     }
 }
 
-/*! Returns the page entry for the page with address PAGE_ADDR. */
-struct page_entry *palloc_addr_to_page_entry(void *page_addr) {
-    struct list *alloc_page_list;
-    struct thread *t = thread_current();
-    struct list_elem *e;
-    struct page_entry *page;
-    bool page_found = false;
-    bool paging_list = false;
+/*! Returns the free address space holding VADDR: the current process's for
+    user addresses, the shared kernel one otherwise. */
+static struct vspace *palloc_vspace(const void *vaddr) {
+    return is_user_vaddr(vaddr) ? &(thread_current()->vspace) : &kernel_vspace;
+}
 
-    /* Look in the process list for the page first. */
-    alloc_page_list = &(t->page_entries);
+/*! Returns the page entry for the page with address PAGE_ADDR, looking in
+    the current process's pages first and then in the paging data, or NULL
+    if the page is not allocated. */
+struct page_entry *palloc_addr_to_page_entry(void *page_addr) {
+    struct page_entry *page = palloc_page_lookup(thread_current(), page_addr);
 
-    while (!page_found) {
+    return page != NULL ? page : palloc_page_lookup(NULL, page_addr);
+}
 
-        /* Find the address in the supplemental page table. */
-        for (e = list_begin(alloc_page_list); e != list_end(alloc_page_list);
-            e = list_next(e))
-        {
-            page = list_entry(e, struct page_entry, elem);
+/*! Returns the bucket of the supplemental page table holding OWNER's page
+    entry for the page containing VADDR, hashed by owner and page number. */
+static struct page_entry **page_bucket(struct thread *owner,
+                                       const void *vaddr) {
+    unsigned hash = hash_int((int) ((uintptr_t) owner ^ pg_no(vaddr)));
 
-            /* If found address, return its supplemental entry */
-            if (((void *) page->vaddr) == page_addr) {
-                return page;
-            }
-            /* If end of paging list, not allocated, return NULL. */
-            else if (list_next(e) == list_end(alloc_page_list) && paging_list) {
-                return NULL;
-            }
+    return &page_table[hash & (page_table_cnt - 1)];
+}
 
-        }
+/*! Returns OWNER's page entry for the page containing VADDR, or NULL. */
+struct page_entry *palloc_page_lookup(struct thread *owner, void *vaddr) {
+    struct page_entry *page;
+    uint8_t *upage = pg_round_down(vaddr);
 
-        /* Move on to paging list if not in process list. */
-        if (!page_found) {
-            paging_list = true;
-            alloc_page_list = init_page_dir_sup;
+    for (page = *page_bucket(owner, upage); page != NULL;
+         page = page->hash_next) {
+        if (page->owner == owner && page->vaddr == upage) {
+            return page;
         }
     }
-
     return NULL;
 }
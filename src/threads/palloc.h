@@ -2,9 +2,19 @@
 #define THREADS_PALLOC_H
 
 #include <stddef.h>
+#include <hash.h>
 #include <list.h>
 #include "vm/falloc.h"
 
+/* The supplemental page table has a power of 2 number of buckets, at least
+   PAGE_HASH_MIN and one for every PAGE_HASH_LOAD pages of RAM.  Each bucket
+   is a chain of page entries. */
+#define PAGE_HASH_MIN 64
+#define PAGE_HASH_LOAD 2
+
+struct swap;
+struct share;
+
 /* How to allocate pages. */
 enum palloc_flags
 {
@@ -13,7 +23,10 @@ enum palloc_flags
     PAL_USER   = 0x04,           /* User page. */
     PAL_PIN    = 0x08,           /* Pin page. */
     PAL_PAGING = 0x10,           /* Paging data. */
-    PAL_READO  = 0x20            /* Read only page. */
+    PAL_READO  = 0x20,           /* Read only page. */
+    PAL_MMAP   = 0x40,           /* Page of a mapped file. */
+    PAL_SHARE  = 0x80,           /* Read-only file page shared by processes. */
+    PAL_LARGE  = 0x100           /* Part of a 4 MB page, given no PTE. */
 };
 
 /* Indicate where to find page data */
@@ -25,19 +38,35 @@ enum page_load
     FRAME_PAGE              /* indicate that page is in a frame */
 };
 
-/*! A struct to store data for the supplemental page table. */
+/*! A struct to store data for the supplemental page table.  Where the data
+    is follows from the source: the file, the swap slot, or, for a page in a
+    frame, the page table entry, which keeps the frame's address even while
+    the page is being evicted.  A shared page is never swapped, so its share
+    takes the place of the swap slot. */
 struct page_entry
 {
     uint8_t *vaddr;                 /*!< Virtual address of page. */
+    struct thread *owner;           /*!< Owning process, NULL for paging data */
+    void *file;                     /*!< File backing the page, or NULL */
+    union
+    {
+        struct swap *swap;          /*!< Swap slot holding a copy, or NULL */
+        struct share *share;        /*!< Shared page mapped, if shared */
+    };
     
-    enum page_load source;          /*!< Location type of page data */
-    void *data;                     /*!< Pointer to data location, unused if zero page */
-    void *f_ofs;                    /*!< Offset inside file */
+    uint32_t f_page : 20;           /*!< Page number of offset inside file */
+    enum page_load source : 2;      /*!< Location type of page data */
+    bool mmap : 1;                  /*!< Written back to file when dirty */
+    bool shared : 1;                /*!< Holds share rather than swap */
     
-    struct list_elem elem;          /*!< Enable putting page entries into list */
+    struct page_entry *hash_next;   /*!< Next entry in its hash bucket */
 };
 
-void palloc_init (void);
+void palloc_init (struct page_entry **buckets, size_t bucket_cnt,
+                  size_t kernel_pages, struct page_entry *boot_pages,
+                  size_t boot_page_cnt);
+void palloc_page_insert(struct page_entry *, struct thread *owner);
+void palloc_page_remove(struct page_entry *);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
@@ -48,10 +77,8 @@ void *palloc_make_multiple_addr(void *, enum palloc_flags, size_t page_cnt, enum
 void *_palloc_get_multiple(enum palloc_flags, size_t page_cnt, enum page_load, void *, void *);
 void *_palloc_get_page(enum palloc_flags flags, enum page_load, void *, void *);
 struct page_entry *palloc_addr_to_page_entry(void *);
-bool palloc_page_less(const struct list_elem *, const struct list_elem *, void*);
+struct page_entry *palloc_page_lookup(struct thread *owner, void *vaddr);
 void* palloc_get_open_addr(bool, size_t);
-struct list_elem *palloc_alloc_elem_after_addr(void *, struct list *, struct list_elem *);
-bool palloc_block_open_list(void *, struct list *, struct list_elem *, size_t);
 
 
 #endif /* threads/palloc.h */
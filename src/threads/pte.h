@@ -76,6 +76,8 @@ static inline uintptr_t pd_no(const void *va) {
 #define PTE_U 0x4               /*!< 1=user/kernel, 0=kernel only. */
 #define PTE_A 0x20              /*!< 1=accessed, 0=not acccessed. */
 #define PTE_D 0x40              /*!< 1=dirty, 0=not dirty (PTEs only). */
+#define PTE_PS 0x80             /*!< 1=4 MB page, 0=page table (PDEs only). */
+#define PTE_G 0x100             /*!< 1=global, kept in TLB across CR3 loads. */
 #define PTE_PIN 0x200           /*!< 1=pinned, 0=not pinned. */
 /*! @} */
 
@@ -89,17 +91,33 @@ static inline uint32_t pde_create(uint32_t *pt) {
     PDE, which must "present", points to. */
 static inline uint32_t *pde_get_pt(uint32_t pde) {
     ASSERT(pde & PTE_P);
-    return ptov(pde & PTE_ADDR);
+    ASSERT(!(pde & PTE_PS));
+    return pmap(pde & PTE_ADDR);
+}
+
+/*! Returns a PDE that maps the writable 4 MB page at physical address
+    PPAGE, which needs CR4.PSE.  If USER is false the page is a global
+    page usable only by the kernel; otherwise user code may use it too. */
+static inline uint32_t pde_create_large(uintptr_t ppage, bool user) {
+    ASSERT((ppage & (PTSPAN - 1)) == 0);
+    return ppage | PTE_PS | PTE_P | PTE_W | PTE_PIN | (user ? PTE_U : PTE_G);
+}
+
+/*! Returns the physical address of the 4 MB page that PDE maps. */
+static inline uintptr_t pde_get_large(uint32_t pde) {
+    ASSERT(pde & PTE_PS);
+    return pde & ~(uint32_t) (PTSPAN - 1);
 }
 
 /*! Returns a PTE that points to PAGE.
     The PTE's page is readable.
     If WRITABLE is true then it will be writable as well.
-    The page will be usable only by ring 0 code (the kernel). */
+    The page will be usable only by ring 0 code (the kernel).  Kernel
+    mappings are the same in every page directory, so the PTE is global. */
 static inline uint32_t pte_create_kernel(void *ppage, bool writable) {
     ASSERT (pg_ofs (ppage) == 0);
     ASSERT ((uint32_t) ppage >> PTSHIFT < init_ram_pages);
-    return ((uint32_t) ppage) | (writable ? PTE_W : 0);
+    return ((uint32_t) ppage) | (writable ? PTE_W : 0) | PTE_G;
 }
 
 /*! Returns a PTE that points to PAGE.
@@ -107,7 +125,7 @@ static inline uint32_t pte_create_kernel(void *ppage, bool writable) {
     If WRITABLE is true then it will be writable as well.
     The page will be usable by both user and kernel code. */
 static inline uint32_t pte_create_user(void *ppage, bool writable) {
-    return pte_create_kernel(ppage, writable) | PTE_U;
+    return (pte_create_kernel(ppage, writable) & ~PTE_G) | PTE_U;
 }
 
 /*! Returns a pointer to the page that page table entry PTE points to. */
@@ -117,16 +135,17 @@ static inline void *pte_get_page(uint32_t pte) {
 
 /*! Returns whether page is pinned or not. */
 static inline bool pte_is_pinned(uint32_t pte) {
-  return (bool) pte & PTE_PIN;
+  return (pte & PTE_PIN) != 0;
 }
 
 /*! Returns whether page is read/write or not. */
 static inline bool pte_is_read_write(uint32_t pte) {
-  return (bool) pte & PTE_W;
+  return (pte & PTE_W) != 0;
 }
 
+/*! Returns whether page is present or not. */
 static inline bool pte_is_present(uint32_t pte) {
-  return (bool) pte & PTE_P;
+  return (pte & PTE_P) != 0;
 }
 
 #endif /* threads/pte.h */
@@ -37,6 +37,16 @@
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 
+static bool sema_waiter_less(const struct heap_elem *,
+                             const struct heap_elem *, void *);
+static bool cond_waiter_less(const struct heap_elem *,
+                             const struct heap_elem *, void *);
+static void lock_take(struct lock *, struct thread *);
+
+/*! Arrival counter, so that waiters of equal priority are woken in the
+    order they started waiting. */
+static unsigned wait_seq;
+
 /*! Initializes semaphore SEMA to VALUE.  A semaphore is a
     nonnegative integer along with two atomic operators for
     manipulating it:
@@ -50,7 +60,7 @@ void sema_init(struct semaphore *sema, unsigned value) {
     ASSERT(sema != NULL);
 
     sema->value = value;
-    list_init(&sema->waiters);
+    heap_init(&sema->waiters, sema_waiter_less, NULL);
 }
 
 /*! Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -68,7 +78,10 @@ void sema_down(struct semaphore *sema) {
 
     old_level = intr_disable();
     while (sema->value == 0) {
-        list_push_back(&sema->waiters, &thread_current()->elem);
+        struct thread *t = thread_current();
+        t->waiting_sema = sema;
+        t->wait_seq = wait_seq++;
+        heap_insert(&sema->waiters, &t->waitelem);
         thread_block();
     }
     sema->value--;
@@ -111,19 +124,15 @@ void sema_up(struct semaphore *sema) {
     old_level = intr_disable();
     
     /* Ensure that highest priority waiting thread is unblocked if one exists. */
-    if (!list_empty(&sema->waiters)) {
-        struct list_elem *e = list_max(&sema->waiters, thread_priority_less, NULL);
-        list_remove(e);
-        thread_unblock(list_entry (e, struct thread, elem));
+    if (!heap_empty(&sema->waiters)) {
+        struct thread *t = heap_entry(heap_pop_max(&sema->waiters),
+                                      struct thread, waitelem);
+        t->waiting_sema = NULL;
+        thread_unblock(t);
         yield = true;
     }
     sema->value++;
 
-    /* Update the priority of the thread if */
-    if (thread_mlfqs) {
-        thread_update_priority();
-    }
-
     intr_set_level(old_level);
 
     /* See if higher priority thread can now run */
@@ -137,6 +146,31 @@ void sema_up(struct semaphore *sema) {
 #endif
 }
 
+/*! Returns true if the thread waiting at A should be woken after the one
+    waiting at B: it has lower priority, or equal priority and arrived
+    later. */
+static bool sema_waiter_less(const struct heap_elem *a,
+                             const struct heap_elem *b, void *aux UNUSED) {
+    const struct thread *ta = heap_entry(a, struct thread, waitelem);
+    const struct thread *tb = heap_entry(b, struct thread, waitelem);
+
+    if (ta->priority != tb->priority)
+        return ta->priority < tb->priority;
+    return (int) (ta->wait_seq - tb->wait_seq) > 0;
+}
+
+/*! Moves T to its new place among the waiters of the semaphore or
+    condition variable it is waiting on, if any, after its priority has
+    changed.  Must be called with interrupts off. */
+void synch_priority_changed(struct thread *t) {
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    if (t->waiting_sema != NULL)
+        heap_update(&t->waiting_sema->waiters, &t->waitelem);
+    if (t->waiting_cond != NULL)
+        heap_update(&t->waiting_cond->waiters, &t->condelem);
+}
+
 static void sema_test_helper(void *sema_);
 
 /*! Self-test for semaphores that makes control "ping-pong"
@@ -201,11 +235,14 @@ void lock_init(struct lock *lock) {
     we need to sleep. */
 void lock_acquire(struct lock *lock) {
     struct thread *t = thread_current();
+    enum intr_level old_level;
 
     ASSERT(lock != NULL);
     ASSERT(!intr_context());
     ASSERT(!lock_held_by_current_thread(lock));
 
+    old_level = intr_disable();
+
     /* Attempting to acquire lock */
     thread_update_lock_to_acquire(t, lock);
 
@@ -217,14 +254,9 @@ void lock_acquire(struct lock *lock) {
     sema_down(&lock->semaphore);
 
     /* Have acquired lock */
-    lock->holder = t;
-
-    /* Update the lock priority to that of new holder, as it should be the
-       highest prority */
-    lock->priority = (lock->holder)->priority;
+    lock_take(lock, t);
 
-    /* Add lock to list of locks held by current thread */
-    thread_acquire_lock(lock);
+    intr_set_level(old_level);
 }
 
 /*! Tries to acquires LOCK and returns true if successful or false
@@ -244,28 +276,46 @@ bool lock_try_acquire(struct lock *lock) {
     /* If successful in aquiring lock, need to update the priority and owner */
     if (success) {
         /* Have acquired lock */
-        lock->holder = thread_current();
-        
-        /* Update the lock priority to that of new holder, as it should be the
-           highest prority */
-        lock->priority = (lock->holder)->priority;
-        /* Add lock to list of locks held by current thread */
-        thread_acquire_lock(lock);
+        enum intr_level old_level = intr_disable();
+        lock_take(lock, thread_current());
+        intr_set_level(old_level);
     }
     /* If failed to acquire, do nothing */
 
     return success;
 }
 
+/*! Makes T, which has just downed LOCK's semaphore, the holder of LOCK.
+    The threads still waiting for LOCK now donate to T.  Must be called
+    with interrupts off. */
+static void lock_take(struct lock *lock, struct thread *t) {
+    lock->holder = t;
+
+    /* The lock's priority is that of its highest priority waiter. */
+    if (heap_empty(&lock->semaphore.waiters))
+        lock->priority = PRI_MIN;
+    else
+        lock->priority = heap_entry(heap_max(&lock->semaphore.waiters),
+                                    struct thread, waitelem)->priority;
+
+    /* Add lock to the locks held by current thread */
+    thread_acquire_lock(lock);
+}
+
 /*! Releases LOCK, which must be owned by the current thread.
 
     An interrupt handler cannot acquire a lock, so it does not
     make sense to try to release a lock within an interrupt
     handler. */
 void lock_release(struct lock *lock) {
+    enum intr_level old_level;
+
     ASSERT(lock != NULL);
     ASSERT(lock_held_by_current_thread(lock));
-    
+
+    /* Keep waiters from donating to us for a lock we no longer hold. */
+    old_level = intr_disable();
+
     /* Tell thread to release the lock */
     thread_release_lock(lock);
 
@@ -274,6 +324,7 @@ void lock_release(struct lock *lock) {
     lock->holder = NULL;
 
     sema_up(&lock->semaphore);
+    intr_set_level(old_level);
 }
 
 /*! Returns true if the current thread holds LOCK, false
@@ -285,38 +336,65 @@ bool lock_held_by_current_thread(const struct lock *lock) {
     return lock->holder == thread_current();
 }
 
+/*! Donates PRIORITY, that of a thread waiting for LOCK, to LOCK's holder,
+    and on along the chain of locks that holders are themselves waiting
+    for, for at most DONATION_DEPTH_MAX locks.  Each step updates the
+    lock's place in its holder's heap of held locks and the holder's
+    place among the waiters of the lock it waits for, so it costs
+    O(log n).  The walk stops as soon as a lock or holder already has at
+    least PRIORITY. */
 void lock_update_priority(struct lock *lock, int priority) {
-    /* New priority of lock is highest of new priority and passed. */
-    lock->priority = (priority > lock->priority) ? priority : lock->priority;
+    enum intr_level old_level = intr_disable();
+    int depth;
+
+    for (depth = 0; depth < DONATION_DEPTH_MAX; depth++) {
+        struct thread *holder;
+
+        if (lock == NULL || lock->holder == NULL || priority <= lock->priority)
+            break;
+        holder = lock->holder;
+
+        /* New priority of lock is the passed one, which is higher. */
+        lock->priority = priority;
+        heap_update(&holder->locks_held, &lock->elem);
+
+        /* Update the priority of the holder, and pass it along to the
+           lock it is trying to acquire */
+        if (priority <= holder->priority)
+            break;
+        thread_change_priority(holder, priority);
+        lock = holder->lock_to_acquire;
+    }
 
-    /* Update the priority of the holder */
-    thread_lock_set_priority(lock->priority, lock->holder);
+    intr_set_level(old_level);
 }
 
-/* Implement a comparison of threads based on time to awake for list elements */
-bool
-lock_priority_less (const struct list_elem* A, const struct list_elem* B,
-                   void* aux UNUSED)
-{
-  int priorityA = list_entry(A, struct lock, elem)->priority;
-  int priorityB = list_entry(B, struct lock, elem)->priority;
-
-  return priorityA < priorityB;
+/*! Compares the priorities donated to two locks held by a thread. */
+bool lock_priority_less(const struct heap_elem *a, const struct heap_elem *b,
+                        void *aux UNUSED) {
+    return heap_entry(a, struct lock, elem)->priority
+         < heap_entry(b, struct lock, elem)->priority;
 }
 
-/*! One semaphore in a list. */
-struct semaphore_elem {
-    struct list_elem elem;              /*!< List element. */
-    struct semaphore semaphore;         /*!< This semaphore. */
-};
-
 /*! Initializes condition variable COND.  A condition variable
     allows one piece of code to signal a condition and cooperating
     code to receive the signal and act upon it. */
 void cond_init(struct condition *cond) {
     ASSERT(cond != NULL);
 
-    list_init(&cond->waiters);
+    heap_init(&cond->waiters, cond_waiter_less, NULL);
+}
+
+/*! Returns true if the thread waiting at A should be signaled after the
+    one waiting at B, as for sema_waiter_less(). */
+static bool cond_waiter_less(const struct heap_elem *a,
+                             const struct heap_elem *b, void *aux UNUSED) {
+    const struct thread *ta = heap_entry(a, struct thread, condelem);
+    const struct thread *tb = heap_entry(b, struct thread, condelem);
+
+    if (ta->priority != tb->priority)
+        return ta->priority < tb->priority;
+    return (int) (ta->cond_seq - tb->cond_seq) > 0;
 }
 
 /*! Atomically releases LOCK and waits for COND to be signaled by
@@ -340,17 +418,27 @@ void cond_init(struct condition *cond) {
     interrupts disabled, but interrupts will be turned back on if
     we need to sleep. */
 void cond_wait(struct condition *cond, struct lock *lock) {
-    struct semaphore_elem waiter;
+    struct thread *t = thread_current();
+    struct semaphore waiter;
+    enum intr_level old_level;
 
     ASSERT(cond != NULL);
     ASSERT(lock != NULL);
     ASSERT(!intr_context());
     ASSERT(lock_held_by_current_thread(lock));
 
-    sema_init(&waiter.semaphore, 0);
-    list_push_back(&cond->waiters, &waiter.elem);
+    /* Interrupts are off around changes to the waiters, since donation
+       may reorder them from another thread. */
+    sema_init(&waiter, 0);
+    old_level = intr_disable();
+    t->waiting_cond = cond;
+    t->cond_sema = &waiter;
+    t->cond_seq = wait_seq++;
+    heap_insert(&cond->waiters, &t->condelem);
+    intr_set_level(old_level);
+
     lock_release(lock);
-    sema_down(&waiter.semaphore);
+    sema_down(&waiter);
     lock_acquire(lock);
 }
 
@@ -367,32 +455,20 @@ void cond_signal(struct condition *cond, struct lock *lock UNUSED) {
     ASSERT(!intr_context ());
     ASSERT(lock_held_by_current_thread (lock));
 
-    if (!list_empty(&cond->waiters)) {
-        /* Ensure that highest priority waiting thread is signaled. */
-        struct list_elem *curr, *e_max;
-        struct list_elem *s, *s_max;
-        struct semaphore *sema, *sema_max;
-        struct thread *t, *t_max;
-        
-        e_max = list_begin(&cond->waiters);
-        sema_max = &list_entry (e_max, struct semaphore_elem, elem)->semaphore;
-        s_max = list_max(&sema_max->waiters, thread_priority_less, NULL);
-        t_max = list_entry (s_max, struct thread, elem);
-        for (curr = list_next(e_max); curr != list_end(&cond->waiters);
-             curr = list_next(curr))  {
-            sema = &list_entry (curr, struct semaphore_elem, elem)->semaphore;
-            s = list_max(&sema->waiters, thread_priority_less, NULL);
-            t = list_entry (s, struct thread, elem);
-            if (t->priority > t_max->priority) {
-                e_max = curr;
-                sema_max = sema;
-                s_max = s;
-                t_max = t;
-            }
-        }
-        list_remove(e_max);
-        sema_up(sema_max);
+    enum intr_level old_level = intr_disable();
+    struct semaphore *sema = NULL;
+
+    /* Signal the highest priority waiting thread. */
+    if (!heap_empty(&cond->waiters)) {
+        struct thread *t = heap_entry(heap_pop_max(&cond->waiters),
+                                      struct thread, condelem);
+        t->waiting_cond = NULL;
+        sema = t->cond_sema;
     }
+    intr_set_level(old_level);
+
+    if (sema != NULL)
+        sema_up(sema);
 }
 
 /*! Wakes up all threads, if any, waiting on COND (protected by
@@ -405,6 +481,6 @@ void cond_broadcast(struct condition *cond, struct lock *lock) {
     ASSERT(cond != NULL);
     ASSERT(lock != NULL);
 
-    while (!list_empty(&cond->waiters))
+    while (!heap_empty(&cond->waiters))
         cond_signal(cond, lock);
 }
@@ -7,13 +7,16 @@
 #ifndef THREADS_SYNCH_H
 #define THREADS_SYNCH_H
 
+#include <heap.h>
 #include <list.h>
 #include <stdbool.h>
 
+struct thread;
+
 /*! A counting semaphore. */
 struct semaphore {
     unsigned value;             /*!< Current value. */
-    struct list waiters;        /*!< List of waiting threads. */
+    struct heap waiters;        /*!< Waiting threads, highest priority first. */
 };
 
 void sema_init(struct semaphore *, unsigned value);
@@ -21,27 +24,34 @@ void sema_down(struct semaphore *);
 bool sema_try_down(struct semaphore *);
 void sema_up(struct semaphore *);
 void sema_self_test(void);
+void synch_priority_changed(struct thread *);
 
 /*! Lock. */
 struct lock {
     
-    struct list_elem elem;      /*!< List element, allows for lists of locks */
-    int priority;               /*!< Priority of the lock */
+    struct heap_elem elem;      /*!< Heap element in holder's locks held */
+    int priority;               /*!< Highest priority donated by a waiter */
     struct thread *holder;      /*!< Thread holding lock (for debugging). */
     struct semaphore semaphore; /*!< Binary semaphore controlling access. */
 };
 
+/*! Longest chain of lock holders that a donation is passed along.  This
+    bounds the work lock_acquire() does with interrupts off.  A donation
+    is dropped for holders further down the chain, which keep the priority
+    they had. */
+#define DONATION_DEPTH_MAX 8
+
 void lock_init(struct lock *);
 void lock_acquire(struct lock *);
 bool lock_try_acquire(struct lock *);
 void lock_release(struct lock *);
 bool lock_held_by_current_thread(const struct lock *);
 void lock_update_priority(struct lock *, int priority);
-bool lock_priority_less(const struct list_elem*, const struct list_elem*, void*);
+bool lock_priority_less(const struct heap_elem*, const struct heap_elem*, void*);
 
 /*! Condition variable. */
 struct condition {
-    struct list waiters;        /*!< List of waiting threads. */
+    struct heap waiters;        /*!< Waiting threads, highest priority first. */
 };
 
 void cond_init(struct condition *);
@@ -1,5 +1,6 @@
 #include "threads/thread.h"
 #include <debug.h>
+#include <inttypes.h>
 #include <stddef.h>
 #include <random.h>
 #include <stdio.h>
@@ -25,16 +26,60 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Run queue of processes in THREAD_READY state, that is, processes
+   that are ready to run but not actually running.  There is one FIFO
+   list per priority level, and a bit in ready_mask for every level
+   whose list is non-empty, so the highest priority ready thread is
+   found with a single bit scan instead of a walk over every thread. */
+#define READY_MASK_WORDS ((PRI_MAX + 32) / 32)
+static struct list ready_queues[PRI_MAX + 1];
+static uint32_t ready_mask[READY_MASK_WORDS];
+
+/* Run queue for the stride scheduler, least pass first.  Every tick a
+   thread runs advances its pass by its stride, STRIDE_ONE divided by
+   its tickets, so threads get the CPU in proportion to their tickets. */
+#define STRIDE_ONE (1 << 20)
+static struct heap stride_queue;
+
+/* Pass of the thread the stride scheduler dispatched last.  A thread
+   that wakes up is moved up to at least this pass, so it cannot claim
+   the time it spent blocked. */
+static int64_t stride_pass;
+
+/* Number of threads in the run queue. */
+static size_t ready_cnt;
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
 static struct list all_list;
 
-/* List of all processes that are blocked from a sleep call. */
-static struct list sleep_list;
+/* Processes that are blocked from a sleep call, kept in a hierarchical
+   timing wheel.  Level 0 has one slot per tick for the next
+   SLEEP_WHEEL_SLOTS ticks, and each slot of a higher level covers as
+   many ticks as the entire level below it.  When the wheel reaches the
+   start of a higher level slot, its threads are cascaded into the lower
+   levels, so sleeping and waking a thread are O(1) and each sleeper is
+   moved at most once per level. */
+#define SLEEP_WHEEL_BITS 6
+#define SLEEP_WHEEL_SLOTS (1 << SLEEP_WHEEL_BITS)
+#define SLEEP_WHEEL_MASK (SLEEP_WHEEL_SLOTS - 1)
+#define SLEEP_WHEEL_LEVELS 4
+#define SLEEP_WHEEL_SPAN ((int64_t) 1 << (SLEEP_WHEEL_BITS * SLEEP_WHEEL_LEVELS))
+static struct list sleep_wheel[SLEEP_WHEEL_LEVELS][SLEEP_WHEEL_SLOTS];
+
+/* Next timer tick the sleep wheel has not yet processed. */
+static int64_t sleep_wheel_ticks;
+
+/* Pages of exited threads kept for reuse, so that thread_create() and
+   the final switch away from a dying thread do not have to go through
+   the page allocator, which walks the kernel's page lists and zeroes
+   and pins a fresh frame each time.  Up to thread_cache_max pages are
+   kept and the rest are freed as usual. */
+#define THREAD_CACHE_DEFAULT 8
+size_t thread_cache_max = THREAD_CACHE_DEFAULT;
+static struct list thread_cache;
+static size_t thread_cache_cnt;
+long long thread_cache_hits;
 
 /* Idle thread. */
 static struct thread *idle_thread;
@@ -67,6 +112,22 @@ static unsigned thread_ticks;   /* # of timer ticks since last yield. */
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* If true, use the stride scheduler.
+   Controlled by kernel command-line option "-stride". */
+bool thread_stride;
+
+/* If true, record scheduler latency histograms.
+   Controlled by kernel command-line option "-schedstat". */
+bool thread_schedstat;
+
+/* Latency histograms of threads that have exited, of the initial thread,
+   and those of destroyed threads kept for reuse.  A thread's histograms
+   are put on the spare list rather than freed, because the last switch
+   away from a dying thread runs with interrupts off. */
+static struct sched_stats exited_sched_stats;
+static struct sched_stats initial_sched_stats;
+static struct list spare_sched_stats;
+
 /* Store the average system load, done as a fixed point number */
 static int64_t load_avg = 0;
 #define DECIMAL_BITS    14
@@ -76,6 +137,17 @@ static int64_t load_avg = 0;
 #define FIXP_59DIV60  (int64_t) (0xFBBBBBBB >> (32-DECIMAL_BITS))
 #define FIXP_01DIV60  (int64_t) (0x04444444 >> (32-DECIMAL_BITS))
 
+/* Decay factors 2*load_avg / (2*load_avg + 1) applied to recent_cpu in
+   each of the last DECAY_HISTORY seconds, indexed by the second modulo
+   DECAY_HISTORY.  Only the running and ready threads are decayed when a
+   second passes; a blocked thread remembers the second it was last
+   decayed in and replays the factors it missed once it is looked at. */
+#define DECAY_HISTORY 256
+static int64_t decay_history[DECAY_HISTORY];
+
+/* Number of once per second mlfqs updates done so far. */
+static int64_t mlfqs_seconds;
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
@@ -84,12 +156,27 @@ static struct thread *next_thread_to_run (void);
 static void init_thread (struct thread *, const char *name, int priority, struct thread *);
 static bool is_thread (struct thread *) UNUSED;
 static void *alloc_frame (struct thread *, size_t size);
+static struct thread *thread_alloc_page (void);
+static void ready_queue_push (struct thread *);
+static void ready_queue_remove (struct thread *);
+static struct thread *ready_queue_pop_max (void);
+static bool thread_pass_less (const struct heap_elem *,
+                              const struct heap_elem *, void *);
+static void sleep_wheel_insert (struct thread *);
+static uint64_t rdtsc (void);
+static void sched_hist_add (uint32_t *hist, uint64_t cycles);
+static struct sched_stats *sched_stats_alloc (void);
+static void sched_stats_add (struct sched_stats *, const struct sched_stats *);
+static void sched_stats_print (const char *name, const struct sched_stats *);
+static void sched_hist_print (const char *name, const uint32_t *hist);
+static void sleep_wheel_cascade (int level);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
 void thread_init_recent_cpu (struct thread *, void *);
 void thread_update_priority_indiv (struct thread *, void *);
-void thread_update_recent_cpu_indiv (struct thread *, void *);
+static int thread_mlfqs_priority (struct thread *);
+static void thread_decay_recent_cpu (struct thread *);
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -108,18 +195,31 @@ void thread_update_recent_cpu_indiv (struct thread *, void *);
 void
 thread_init (void)
 {
+  int i, j;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
   lock_init (&tid_lock);
-  list_init (&ready_list);
+  for (i = 0; i <= PRI_MAX; i++)
+    list_init (&ready_queues[i]);
+  heap_init (&stride_queue, thread_pass_less, NULL);
   list_init (&all_list);
-  list_init (&sleep_list);
+  list_init (&thread_cache);
+  list_init (&spare_sched_stats);
+  for (i = 0; i < SLEEP_WHEEL_LEVELS; i++)
+    for (j = 0; j < SLEEP_WHEEL_SLOTS; j++)
+      list_init (&sleep_wheel[i][j]);
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
   init_thread (initial_thread, "main", PRI_DEFAULT, NULL); // initial has no parent
   initial_thread->status = THREAD_RUNNING;
   initial_thread->tid = allocate_tid ();
+  if (thread_schedstat)
+  {
+    initial_thread->sched_stats = &initial_sched_stats;
+    initial_thread->state_stamp = rdtsc ();
+  }
 }
 
 /* Starts preemptive thread scheduling by enabling interrupts.
@@ -150,6 +250,8 @@ thread_tick (void)
   if(t != idle_thread)
   {
     t->recent_cpu += FIXP_F;
+    if (thread_stride)
+      t->pass += STRIDE_ONE / t->tickets;
   }
 
   /* Update statistics. */
@@ -167,10 +269,20 @@ thread_tick (void)
     intr_yield_on_return ();
 }
 
+/* Called by the timer for each tick that passed while the CPU was halted
+   in the idle thread with the timer stopped.  Runs with interrupts off,
+   but not necessarily in an interrupt context. */
+void
+thread_tick_idle (void)
+{
+  idle_ticks++;
+}
+
 /* Reset a threads recent_cpu value, used to enable a thread_foreach call */
 void thread_init_recent_cpu (struct thread * t, void *aux UNUSED)
 {
   t->recent_cpu = 0;
+  t->recent_cpu_stamp = mlfqs_seconds;
 }
 
 /* Reset the values for the mlfqs */
@@ -190,6 +302,115 @@ thread_print_stats (void)
 {
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+
+  if (thread_schedstat)
+  {
+    struct sched_stats total = exited_sched_stats;
+    struct list_elem *e;
+    enum intr_level old_level = intr_disable ();
+
+    for (e = list_begin (&all_list); e != list_end (&all_list);
+         e = list_next (e))
+      sched_stats_add (&total, list_entry (e, struct thread,
+                                           allelem)->sched_stats);
+    intr_set_level (old_level);
+
+    printf ("Scheduler latency, as log2(cycles):count\n");
+    sched_stats_print ("all threads", &total);
+    for (e = list_begin (&all_list); e != list_end (&all_list);
+         e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, allelem);
+      if (t != idle_thread)
+        sched_stats_print (t->name, t->sched_stats);
+    }
+  }
+}
+
+/* Prints the histograms in STATS under the heading NAME. */
+static void
+sched_stats_print (const char *name, const struct sched_stats *stats)
+{
+  printf ("  %s:\n", name);
+  sched_hist_print ("ready", stats->ready);
+  sched_hist_print ("slice", stats->slice);
+  sched_hist_print ("blocked", stats->blocked);
+}
+
+/* Prints the non-empty buckets of HIST on one line labelled NAME. */
+static void
+sched_hist_print (const char *name, const uint32_t *hist)
+{
+  int i;
+
+  printf ("    %-8s", name);
+  for (i = 0; i < SCHED_HIST_BUCKETS; i++)
+    if (hist[i] != 0)
+      printf (" %d:%"PRIu32, i, hist[i]);
+  printf ("\n");
+}
+
+/* Adds every bucket of B into A. */
+static void
+sched_stats_add (struct sched_stats *a, const struct sched_stats *b)
+{
+  int i;
+
+  for (i = 0; i < SCHED_HIST_BUCKETS; i++)
+  {
+    a->ready[i] += b->ready[i];
+    a->slice[i] += b->slice[i];
+    a->blocked[i] += b->blocked[i];
+  }
+}
+
+/* Returns zeroed histograms for a new thread, reusing those of a
+   destroyed thread if there are any, or a null pointer if memory is
+   exhausted. */
+static struct sched_stats *
+sched_stats_alloc (void)
+{
+  struct sched_stats *stats = NULL;
+  enum intr_level old_level = intr_disable ();
+
+  if (!list_empty (&spare_sched_stats))
+    stats = list_entry (list_pop_front (&spare_sched_stats),
+                        struct sched_stats, elem);
+  intr_set_level (old_level);
+
+  if (stats == NULL)
+    stats = malloc (sizeof *stats);
+  if (stats != NULL)
+    memset (stats, 0, sizeof *stats);
+  return stats;
+}
+
+/* Counts an interval of CYCLES in its log2 bucket of HIST. */
+static void
+sched_hist_add (uint32_t *hist, uint64_t cycles)
+{
+  uint32_t high = cycles >> 32, low = cycles, bit = 0;
+
+  /* Index of the most significant set bit, see [IA32-v2a] "BSR". */
+  if (high != 0)
+  {
+    asm ("bsrl %1, %0" : "=r" (bit) : "rm" (high));
+    bit += 32;
+  }
+  else if (low != 0)
+    asm ("bsrl %1, %0" : "=r" (bit) : "rm" (low));
+
+  hist[bit < SCHED_HIST_BUCKETS ? bit : SCHED_HIST_BUCKETS - 1]++;
+}
+
+/* Returns the CPU's time stamp counter, see [IA32-v2b] "RDTSC". */
+static uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -214,17 +435,29 @@ thread_create (const char *name, int priority, thread_func *function, void *aux)
   struct kernel_thread_frame *kf;
   struct switch_entry_frame *ef;
   struct switch_threads_frame *sf;
+  struct sched_stats *stats = NULL;
   tid_t tid;
 
   ASSERT (function != NULL);
 
   /* Allocate thread. */
-  t = palloc_get_page (PAL_PAGING | PAL_PIN | PAL_ZERO);
+  if (thread_schedstat)
+  {
+    stats = sched_stats_alloc ();
+    if (stats == NULL)
+      return TID_ERROR;
+  }
+  t = thread_alloc_page ();
   if (t == NULL)
+  {
+    if (stats != NULL)
+      free (stats);
     return TID_ERROR;
+  }
 
   /* Initialize thread. */
   init_thread (t, name, priority, thread_current());
+  t->sched_stats = stats;
   tid = t->tid = allocate_tid ();
 
   /* Add thread to list of children. */
@@ -289,8 +522,24 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  list_push_back (&ready_list, &t->elem);
+  if (thread_schedstat)
+  {
+    /* A new thread has never blocked, so it has no stamp yet. */
+    uint64_t now = rdtsc ();
+    if (t->state_stamp != 0)
+      sched_hist_add (t->sched_stats->blocked, now - t->state_stamp);
+    t->state_stamp = now;
+  }
+  if (thread_mlfqs)
+  {
+    /* Catch up on the decay missed while blocked. */
+    thread_decay_recent_cpu (t);
+    t->priority = thread_mlfqs_priority (t);
+  }
+  if (thread_stride && t->pass < stride_pass)
+    t->pass = stride_pass;
   t->status = THREAD_READY;
+  ready_queue_push (t);
   intr_set_level (old_level);
 }
 
@@ -307,10 +556,10 @@ thread_sleep (int64_t ticks)
 
   ASSERT(intr_get_level () == INTR_ON);
 
-  /* Set the sleep time in the current thread and add to sleeping list */
+  /* Set the sleep time in the current thread and add to sleeping wheel */
   old_level = intr_disable ();  /* Disable intr so timer won't start early */
   t->time_to_awake = ticks + timer_ticks() - 1;
-  list_insert_ordered (&sleep_list, &t->elem, thread_sleep_less, NULL);
+  sleep_wheel_insert (t);
 
   /* Set thread to blocked */
   thread_block ();
@@ -319,33 +568,101 @@ thread_sleep (int64_t ticks)
   intr_set_level (old_level);
 }
 
-/* Goes through the list of sleeping thread to decrement the time left to sleep
-   and awakens them automatically when the time expires. */
+/* Advances the sleep wheel up to the current tick, awakening every
+   thread whose time to awake has been reached. */
 void
 thread_check_awaken (void)
 {
   int64_t curr_ticks = timer_ticks();
-  struct thread *t;
-  struct list_elem *del, *curr = list_begin (&sleep_list);
+  struct list *slot;
+  int level;
 
-  /* Go through list of sleeping threads */
-  while (curr != list_end (&sleep_list))
+  while (sleep_wheel_ticks <= curr_ticks)
   {
-    t = list_entry (curr, struct thread, elem);
-    /* Remove thread if time expired and unblock*/
-    if (t->time_to_awake <= curr_ticks)
-    {
-      del = curr;
-      curr = list_next (curr);
-      list_remove(del);
-      thread_unblock(t);
-    }
-    /* Move to next thread otherwise */
-    else
+    /* Find the levels whose current slot starts on this tick, and
+       cascade them from the highest down so that their threads land in
+       the proper lower level slots. */
+    for (level = 1; level < SLEEP_WHEEL_LEVELS; level++)
     {
-      break;
+      int64_t mask = ((int64_t) 1 << (SLEEP_WHEEL_BITS * level)) - 1;
+      if ((sleep_wheel_ticks & mask) != 0)
+        break;
     }
+    while (--level > 0)
+      sleep_wheel_cascade (level);
+
+    /* Awaken all threads due on this tick. */
+    slot = &sleep_wheel[0][sleep_wheel_ticks & SLEEP_WHEEL_MASK];
+    while (!list_empty (slot))
+      thread_unblock (list_entry (list_pop_front (slot), struct thread, elem));
+
+    sleep_wheel_ticks++;
+  }
+}
+
+/* Returns the earliest tick on which thread_check_awaken() may awaken a
+   thread.  Only looks SLEEP_WHEEL_SLOTS ticks ahead; if no thread is due
+   by then, returns the first tick past that. */
+int64_t
+thread_next_awaken (void)
+{
+  int64_t tick;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (tick = sleep_wheel_ticks; tick < sleep_wheel_ticks + SLEEP_WHEEL_SLOTS;
+       tick++)
+  {
+    /* Threads cascading down on this tick may be due right away. */
+    if ((tick & SLEEP_WHEEL_MASK) == 0)
+      return tick;
+    if (!list_empty (&sleep_wheel[0][tick & SLEEP_WHEEL_MASK]))
+      return tick;
   }
+  return tick;
+}
+
+/* Adds sleeping thread T to the slot of the sleep wheel covering its
+   time to awake.  Must be called with interrupts off. */
+static void
+sleep_wheel_insert (struct thread *t)
+{
+  int64_t expires = t->time_to_awake;
+  int level;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* Threads already due wake on the next tick processed, and threads
+     beyond the span of the wheel are parked in the furthest slot, to be
+     sorted again when it cascades. */
+  if (expires < sleep_wheel_ticks)
+    expires = sleep_wheel_ticks;
+  else if (expires - sleep_wheel_ticks >= SLEEP_WHEEL_SPAN)
+    expires = sleep_wheel_ticks + SLEEP_WHEEL_SPAN - 1;
+
+  for (level = 0; level < SLEEP_WHEEL_LEVELS - 1; level++)
+    if (expires - sleep_wheel_ticks < (int64_t) 1 << (SLEEP_WHEEL_BITS * (level + 1)))
+      break;
+
+  list_push_back (&sleep_wheel[level][(expires >> (SLEEP_WHEEL_BITS * level))
+                                      & SLEEP_WHEEL_MASK], &t->elem);
+}
+
+/* Moves every thread in the current slot of LEVEL of the sleep wheel
+   into the lower level slots matching its time to awake. */
+static void
+sleep_wheel_cascade (int level)
+{
+  struct list *slot = &sleep_wheel[level][(sleep_wheel_ticks >> (SLEEP_WHEEL_BITS * level))
+                                          & SLEEP_WHEEL_MASK];
+  struct list pending;
+
+  /* Empty the slot first, as parked threads may be reinserted into it. */
+  list_init (&pending);
+  list_splice (list_end (&pending), list_begin (slot), list_end (slot));
+
+  while (!list_empty (&pending))
+    sleep_wheel_insert (list_entry (list_pop_front (&pending), struct thread, elem));
 }
 
 /* Returns the name of the running thread. */
@@ -436,7 +753,7 @@ thread_exit (void)
     if (child->status == THREAD_ZOMBIE)
     {
       /* Destroy thread here as scheduler wont see it as prev. */
-      palloc_free_page (child);
+      thread_free_page (child);
     }
     /* Otherwise set to no parent. */
     else
@@ -455,6 +772,58 @@ thread_exit (void)
   NOT_REACHED ();
 }
 
+/* Returns a page for a new thread, from the cache of exited threads'
+   pages if it has one. */
+static struct thread *
+thread_alloc_page (void)
+{
+  struct thread *t = NULL;
+  enum intr_level old_level = intr_disable ();
+
+  if (!list_empty (&thread_cache))
+  {
+    t = list_entry (list_pop_front (&thread_cache), struct thread, elem);
+    thread_cache_cnt--;
+    thread_cache_hits++;
+  }
+  intr_set_level (old_level);
+
+  if (t == NULL)
+    t = palloc_get_page (PAL_PAGING | PAL_PIN | PAL_ZERO);
+  return t;
+}
+
+/* Destroys exited thread T, keeping its page for reuse by
+   thread_create() unless the cache is already full. */
+void
+thread_free_page (struct thread *t)
+{
+  enum intr_level old_level;
+
+  ASSERT (is_thread (t));
+  ASSERT (t != running_thread ());
+
+  old_level = intr_disable ();
+  if (t->sched_stats != NULL)
+  {
+    sched_stats_add (&exited_sched_stats, t->sched_stats);
+    list_push_front (&spare_sched_stats, &t->sched_stats->elem);
+    t->sched_stats = NULL;
+  }
+  if (thread_cache_cnt < thread_cache_max)
+  {
+    /* Clear the magic so stale pointers to T are caught. */
+    t->magic = 0;
+    list_push_front (&thread_cache, &t->elem);
+    thread_cache_cnt++;
+    t = NULL;
+  }
+  intr_set_level (old_level);
+
+  if (t != NULL)
+    palloc_free_page (t);
+}
+
 /* Yields the CPU.  The current thread is not put to sleep and
    may be scheduled again immediately at the scheduler's whim. */
 void
@@ -468,9 +837,9 @@ thread_yield (void)
   if (running_thread ()->status != THREAD_ZOMBIE)
   {
     struct thread *cur = thread_current ();
-    if (cur != idle_thread)
-      list_push_back (&ready_list, &cur->elem);
     cur->status = THREAD_READY;
+    if (cur != idle_thread)
+      ready_queue_push (cur);
   }
   schedule ();
   intr_set_level (old_level);
@@ -498,6 +867,7 @@ void
 thread_set_priority (int new_priority)
 {
   enum intr_level old_level;
+  int priority;
 
   /* Disable if advanced scheduler enabled */
   if (thread_mlfqs)
@@ -513,8 +883,9 @@ thread_set_priority (int new_priority)
   old_level = intr_disable ();
 
   /* Set priority to max of donations or the actual priority */
-  t_curr->priority = thread_lock_max_priority(t_curr);
-  t_curr->priority = (new_priority > t_curr->priority) ? new_priority : t_curr->priority;
+  priority = thread_lock_max_priority(t_curr);
+  thread_change_priority (t_curr,
+                          (new_priority > priority) ? new_priority : priority);
 
   /* If there is a lock to aquire, update its priority */
   if (t_curr->lock_to_acquire != NULL)
@@ -528,24 +899,6 @@ thread_set_priority (int new_priority)
   thread_yield();
 }
 
-/* Sets the current thread's acting priority to NEW_PRIORITY. */
-void
-thread_lock_set_priority (int new_priority, struct thread *t)
-{
-  /* If the priority has changed, propagate it to acquiring lock */
-  if (new_priority > t->priority)
-  {
-    /* Update the priority of the thread */
-    t->priority = new_priority;
-
-    /* If there is a lock to aquire, update its priority */
-    if (t->lock_to_acquire != NULL)
-    {
-      lock_update_priority(t->lock_to_acquire, new_priority);
-    }
-  }
-}
-
 /* Returns the current thread's priority. */
 int
 thread_get_priority (void)
@@ -553,9 +906,9 @@ thread_get_priority (void)
   return thread_current()->priority;
 }
 
-/* Update the priority of a thread for the mlfqs */
-void
-thread_update_priority_indiv (struct thread* t, void* aux UNUSED)
+/* Computes the mlfqs priority of a thread from its recent_cpu and nice */
+static int
+thread_mlfqs_priority (struct thread *t)
 {
   int priority;
 
@@ -567,21 +920,39 @@ thread_update_priority_indiv (struct thread* t, void* aux UNUSED)
   priority = (priority < PRI_MIN) ? PRI_MIN : priority;
   priority = (priority > PRI_MAX) ? PRI_MAX : priority;
 
-  t->priority = priority;
+  return priority;
+}
+
+/* Update the priority of a thread for the mlfqs */
+void
+thread_update_priority_indiv (struct thread* t, void* aux UNUSED)
+{
+  thread_change_priority (t, thread_mlfqs_priority (t));
 }
 
-/* Update the priority of all threads for the mlfqs */
+/* Update the priority of the running thread for the mlfqs.  Between the
+   once per second decays only the running thread's recent_cpu changes,
+   so every other thread's priority is still current. */
 void
 thread_update_priority (void)
 {
-  thread_foreach(thread_update_priority_indiv, NULL);
+  struct thread *t = running_thread ();
+
+  if (t != idle_thread)
+    thread_update_priority_indiv (t, NULL);
 }
 
 /* Sets the current thread's nice value to NICE. */
 void
 thread_set_nice (int nice)
 {
+  enum intr_level old_level = intr_disable ();
+
   thread_current()->nice = nice;
+  if (thread_mlfqs)
+    thread_update_priority ();
+
+  intr_set_level (old_level);
 }
 
 /* Returns the current thread's nice value. */
@@ -591,6 +962,24 @@ thread_get_nice (void)
   return thread_current()->nice;
 }
 
+/* Returns the current thread's stride scheduler tickets. */
+int
+thread_get_tickets (void)
+{
+  return thread_current ()->tickets;
+}
+
+/* Sets the current thread's stride scheduler tickets to TICKETS, which
+   must be between TICKETS_MIN and TICKETS_MAX.  It takes effect from
+   the next tick the thread runs. */
+void
+thread_set_tickets (int tickets)
+{
+  ASSERT (TICKETS_MIN <= tickets && tickets <= TICKETS_MAX);
+
+  thread_current ()->tickets = tickets;
+}
+
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void)
@@ -603,10 +992,10 @@ thread_get_load_avg (void)
 void
 thread_update_load_avg (void)
 {
-  /* Compute new value of the system load average */
-  load_avg *= FIXP_59DIV60; /* load_avg *= 59/60 as fixed point */
-  load_avg /= FIXP_F;
-  load_avg += FIXP_01DIV60 * (int64_t)list_size(&ready_list);
+  /* Compute new value of the system load average, which is never
+     negative, so the fixed point product can be scaled with a shift */
+  load_avg = (load_avg * FIXP_59DIV60) >> DECIMAL_BITS;
+  load_avg += FIXP_01DIV60 * (int64_t)ready_cnt;
 
   /* If we are currently running a thread */
   if (running_thread() != idle_thread)
@@ -624,28 +1013,61 @@ thread_get_recent_cpu (void)
     return 100 * thread_current ()->recent_cpu / FIXP_F;
 }
 
-/* Update the value for recent_cpu */
-void
-thread_update_recent_cpu_indiv (struct thread* t, void* aux UNUSED)
+/* Applies the once per second decays of recent_cpu that T has missed
+   since it was last brought up to date.  Seconds that have fallen out
+   of decay_history are replayed with the oldest factor still kept,
+   stopping early once recent_cpu settles. */
+static void
+thread_decay_recent_cpu (struct thread *t)
 {
-  int64_t recent_cpu;
+  int64_t oldest = mlfqs_seconds - DECAY_HISTORY;
+  int64_t second, recent_cpu;
 
-  /* Fetch the current recent_cpu value */
-  recent_cpu = t->recent_cpu;
-
-  /* Update the value */
-  recent_cpu *= (2*load_avg);
-  recent_cpu /= (2*load_avg + 1*FIXP_F);
-  recent_cpu += t->nice * FIXP_F;
+  for (; t->recent_cpu_stamp < mlfqs_seconds; t->recent_cpu_stamp++)
+  {
+    second = (t->recent_cpu_stamp < oldest) ? oldest : t->recent_cpu_stamp;
+    recent_cpu = decay_history[second & (DECAY_HISTORY - 1)] * t->recent_cpu;
+    recent_cpu = (recent_cpu >> DECIMAL_BITS) + t->nice * FIXP_F;
 
-  /* Put it back in the thread struct */
-  t->recent_cpu = recent_cpu;
+    if (recent_cpu == t->recent_cpu && t->recent_cpu_stamp < oldest)
+      t->recent_cpu_stamp = oldest - 1;
+    t->recent_cpu = recent_cpu;
+  }
 }
 
+/* Decay recent_cpu for the second that just passed.  Only the running
+   thread and the threads in the run queue are decayed here, and the
+   ready threads are requeued at their new priorities on the way.
+   Blocked threads catch up when they are woken, so while they wait
+   their order among a semaphore's waiters is that of when they
+   blocked. */
 void
 thread_update_recent_cpu (void)
 {
-  thread_foreach (thread_update_recent_cpu_indiv, NULL);
+  struct thread *t;
+  struct list ready;
+  int64_t twice_load = 2 * load_avg;
+
+  /* The one division of the second; each decay is a multiply and shift */
+  decay_history[mlfqs_seconds & (DECAY_HISTORY - 1)] =
+    (twice_load << DECIMAL_BITS) / (twice_load + FIXP_F);
+  mlfqs_seconds++;
+
+  t = running_thread ();
+  if (t != idle_thread)
+    thread_decay_recent_cpu (t);
+
+  /* Empty the run queue highest priority first, then refill it */
+  list_init (&ready);
+  while (ready_cnt > 0)
+    list_push_back (&ready, &ready_queue_pop_max ()->elem);
+  while (!list_empty (&ready))
+  {
+    t = list_entry (list_pop_front (&ready), struct thread, elem);
+    thread_decay_recent_cpu (t);
+    t->priority = thread_mlfqs_priority (t);
+    ready_queue_push (t);
+  }
 }
 
 
@@ -667,10 +1089,16 @@ idle (void *idle_started_ UNUSED)
 
   for (;;)
     {
-      /* Let someone else run. */
+      /* Let someone else run, with the periodic timer going again if an
+         interrupt other than the timer's woke us from a tickless halt. */
       intr_disable ();
+      timer_idle_exit ();
       thread_block ();
 
+      /* Nothing else is ready to run, so stop the timer until the next
+         sleeping thread is due, if tickless idle is enabled. */
+      timer_idle_enter ();
+
       /* Re-enable interrupts and wait for the next one.
 
          The `sti' instruction disables interrupts until the
@@ -740,8 +1168,10 @@ init_thread (struct thread *t, const char *name, int priority, struct thread *t_
   t->stack = (uint8_t *) t + PGSIZE;
   t->magic = THREAD_MAGIC;
 
-  t->nice = 0;
+  t->nice = NICE_DEFAULT;
   t->recent_cpu = 0;
+  t->tickets = TICKETS_DEFAULT;
+  t->recent_cpu_stamp = mlfqs_seconds;
   /* Initially, original priority is same as working priority */
   if (thread_mlfqs)
   {
@@ -754,7 +1184,7 @@ init_thread (struct thread *t, const char *name, int priority, struct thread *t_
   t->orig_priority = t->priority;
 
   /* Initialize the list of locks held */
-  list_init (&(t->locks_held));
+  heap_init (&(t->locks_held), lock_priority_less, NULL);
 
   /* Initially no lock held */
   t->lock_to_acquire = NULL;
@@ -769,13 +1199,16 @@ init_thread (struct thread *t, const char *name, int priority, struct thread *t_
   sema_init(&(t->child_loaded), 0);
   t->parent = t_par;
   t->executable = NULL;
+  t->tlb_batch = NULL;
 #endif
 
   list_init(&(t->swaps));
-  list_init(&(t->frames));
-  list_init(&(t->page_entries));
+  list_init(&(t->mmaps));
   
   t->stack_bottom = PHYS_BASE - PGSIZE;
+  t->user_esp = NULL;
+  t->fault_around_next = NULL;
+  t->fault_around = 0;
 
   old_level = intr_disable ();
   list_push_back (&all_list, &t->allelem);
@@ -795,6 +1228,117 @@ alloc_frame (struct thread *t, size_t size)
   return t->stack;
 }
 
+/* Adds ready thread T to the back of the run queue for its priority,
+   or to the stride scheduler's run queue. */
+static void
+ready_queue_push (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->status == THREAD_READY);
+
+  if (thread_stride)
+    heap_insert (&stride_queue, &t->passelem);
+  else
+  {
+    list_push_back (&ready_queues[t->priority], &t->elem);
+    ready_mask[t->priority / 32] |= 1u << (t->priority % 32);
+  }
+  ready_cnt++;
+}
+
+/* Removes ready thread T from the run queue. */
+static void
+ready_queue_remove (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->status == THREAD_READY);
+
+  if (thread_stride)
+    heap_remove (&stride_queue, &t->passelem);
+  else
+  {
+    list_remove (&t->elem);
+    if (list_empty (&ready_queues[t->priority]))
+      ready_mask[t->priority / 32] &= ~(1u << (t->priority % 32));
+  }
+  ready_cnt--;
+}
+
+/* Removes and returns the first thread of the highest non-empty
+   priority level, or with the stride scheduler the thread with the
+   least pass, or a null pointer if the run queue is empty. */
+static struct thread *
+ready_queue_pop_max (void)
+{
+  struct thread *t;
+  uint32_t bit;
+  int word;
+
+  if (thread_stride)
+  {
+    if (heap_empty (&stride_queue))
+      return NULL;
+    t = heap_entry (heap_max (&stride_queue), struct thread, passelem);
+    ready_queue_remove (t);
+    return t;
+  }
+
+  for (word = READY_MASK_WORDS - 1; word >= 0; word--)
+    if (ready_mask[word] != 0)
+      {
+        /* Index of the most significant set bit, see [IA32-v2a] "BSR". */
+        asm ("bsrl %1, %0" : "=r" (bit) : "rm" (ready_mask[word]));
+        t = list_entry (list_front (&ready_queues[word * 32 + bit]),
+                        struct thread, elem);
+        ready_queue_remove (t);
+        return t;
+      }
+  return NULL;
+}
+
+/* Returns true if thread A, at passelem, should run after thread B:
+   it has the greater pass, or the same pass and a later tid. */
+static bool
+thread_pass_less (const struct heap_elem *a, const struct heap_elem *b,
+                  void *aux UNUSED)
+{
+  const struct thread *ta = heap_entry (a, struct thread, passelem);
+  const struct thread *tb = heap_entry (b, struct thread, passelem);
+
+  if (ta->pass != tb->pass)
+    return ta->pass > tb->pass;
+  return ta->tid > tb->tid;
+}
+
+/* Sets the working priority of T to PRIORITY, moving T to the back of
+   the matching run queue if it is currently ready to run, or to its
+   new place among the waiters of the semaphore or condition it is
+   waiting on. */
+void
+thread_change_priority (struct thread *t, int priority)
+{
+  enum intr_level old_level;
+
+  ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+  if (t->priority == priority)
+    return;
+
+  old_level = intr_disable ();
+  if (t->status == THREAD_READY)
+  {
+    ready_queue_remove (t);
+    t->priority = priority;
+    ready_queue_push (t);
+  }
+  else
+  {
+    t->priority = priority;
+    synch_priority_changed (t);
+  }
+  intr_set_level (old_level);
+}
+
 /* Chooses and returns the next thread to be scheduled.  Should
    return a thread from the run queue, unless the run queue is
    empty.  (If the running thread can continue running, then it
@@ -803,21 +1347,18 @@ alloc_frame (struct thread *t, size_t size)
 static struct thread *
 next_thread_to_run (void)
 {
-  if (list_empty (&ready_list))
-    return idle_thread;
-  /* Use priority donation so take absolute maximum priority thread
+  /* Use priority donation so take absolute maximum priority thread.
      Works with advanced scheduler as takes first element of the highest
      priority level, which is removed. On yielding, it will be pushed onto the
-     end of the list.
+     end of its level.
   */
-  else
-  {
-    /* Search for maximum priority thread */
-    struct list_elem *max = list_max (&ready_list, thread_priority_less, NULL);
-    struct thread *t = list_entry (max, struct thread, elem);
-    list_remove (max);
-    return t;
-  }
+  struct thread *t = ready_queue_pop_max ();
+
+  if (t == NULL)
+    return idle_thread;
+  if (thread_stride)
+    stride_pass = t->pass;
+  return t;
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -849,6 +1390,23 @@ thread_schedule_tail (struct thread *prev)
   /* Start new time slice. */
   thread_ticks = 0;
 
+  /* Record how long PREV ran and CUR waited to run.  PREV's stamp then
+     marks when it blocked or became ready again. */
+  if (thread_schedstat && prev != NULL)
+  {
+    uint64_t now = rdtsc ();
+    if (prev != idle_thread)
+    {
+      sched_hist_add (prev->sched_stats->slice, now - prev->state_stamp);
+      prev->state_stamp = now;
+    }
+    if (cur != idle_thread)
+    {
+      sched_hist_add (cur->sched_stats->ready, now - cur->state_stamp);
+      cur->state_stamp = now;
+    }
+  }
+
 #ifdef USERPROG
   /* Activate the new address space. */
   process_activate ();
@@ -862,7 +1420,7 @@ thread_schedule_tail (struct thread *prev)
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread)
   {
     ASSERT (prev != cur);
-    palloc_free_page (prev);
+    thread_free_page (prev);
   }
 }
 
@@ -907,20 +1465,15 @@ allocate_tid (void)
    Used by switch.S, which can't figure it out on its own. */
 uint32_t thread_stack_ofs = offsetof (struct thread, stack);
 
-/* Return the highest priority among locks held by the passed thread. */
+/* Return the highest priority among locks held by the passed thread.
+   The held locks are kept in a heap by donated priority, so this is
+   just its top. */
 int
 thread_lock_max_priority (struct thread *t)
 {
-  int max_priority = PRI_MIN;
-
-  /* Replace with max priority from locks if holding any */
-  if (!list_empty (&t->locks_held))
-  {
-    struct list_elem *e = list_max (&t->locks_held, lock_priority_less, NULL);
-    max_priority = list_entry (e, struct lock, elem)->priority;
-  }
-
-  return max_priority;
+  if (heap_empty (&t->locks_held))
+    return PRI_MIN;
+  return heap_entry (heap_max (&t->locks_held), struct lock, elem)->priority;
 }
 
 /* Updates the lock that the thread is trying to acquire. */
@@ -930,51 +1483,43 @@ thread_update_lock_to_acquire (struct thread *t, struct lock *l)
   t->lock_to_acquire = l;
 }
 
-/* Adds the passed lock to the list of locks held by the current thread. */
+/* Adds the passed lock to the locks held by the current thread, taking
+   on the donations of the lock's remaining waiters. */
 void
 thread_acquire_lock (struct lock *l)
 {
   struct thread *t = thread_current();
+  enum intr_level old_level = intr_disable ();
+
   t->lock_to_acquire = NULL;
 
-  /* Add lock to the list of locks held */
-  list_push_back(&(t->locks_held), &(l->elem));
+  /* Add lock to the heap of locks held */
+  heap_insert (&t->locks_held, &l->elem);
+  if (l->priority > t->priority)
+    thread_change_priority (t, l->priority);
+
+  intr_set_level (old_level);
 }
 
-/* Removes the passed lock from the list of locks held by the current thread. */
+/* Removes the passed lock from the locks held by the current thread. */
 void
 thread_release_lock (struct lock *l)
 {
   /* Only current thread could be releasing a lock */
   struct thread *t = thread_current();
+  enum intr_level old_level;
+  int priority;
 
   ASSERT(l != NULL);
 
-  /* Remove released lock from list of held locks */
-  list_remove(&(l->elem));
-  /* Update priority based on remaining locks */
-  t->priority = thread_lock_max_priority(t);
-  t->priority = (t->orig_priority > t->priority) ? t->orig_priority : t->priority;
-}
-
-/* Implement a comparison of threads based on priority for list elements */
-bool
-thread_priority_less (const struct list_elem* A, const struct list_elem* B,
-                      void* aux UNUSED)
-{
-  int priorityA = list_entry(A, struct thread, elem)->priority;
-  int priorityB = list_entry(B, struct thread, elem)->priority;
-
-  return priorityA < priorityB;
-}
+  old_level = intr_disable ();
 
-/* Implement a comparison of threads based on time to awake for list elements */
-bool
-thread_sleep_less (const struct list_elem* A, const struct list_elem* B,
-                   void* aux UNUSED)
-{
-  int sleepA = list_entry(A, struct thread, elem)->time_to_awake;
-  int sleepB = list_entry(B, struct thread, elem)->time_to_awake;
+  /* Remove released lock from heap of held locks */
+  heap_remove (&t->locks_held, &l->elem);
+  /* Update priority based on remaining locks */
+  priority = thread_lock_max_priority(t);
+  thread_change_priority (t, (t->orig_priority > priority) ? t->orig_priority
+                                                          : priority);
 
-  return sleepA < sleepB;
+  intr_set_level (old_level);
 }
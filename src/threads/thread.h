@@ -7,9 +7,13 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <heap.h>
 #include <list.h>
 #include <stdint.h>
 #include "synch.h"
+#include "vm/vspace.h"
+
+struct tlb_batch;
 
 /*! States in a thread's life cycle. */
 enum thread_status {
@@ -30,6 +34,31 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /*!< Default priority. */
 #define PRI_MAX 63                      /*!< Highest priority. */
 
+/* Thread niceness, for the multi-level feedback queue scheduler. */
+#define NICE_MIN -20                    /*!< Least nice. */
+#define NICE_DEFAULT 0                  /*!< Default niceness. */
+#define NICE_MAX 20                     /*!< Nicest. */
+
+/* Thread tickets, for the stride scheduler. */
+#define TICKETS_MIN 1                   /*!< Fewest tickets. */
+#define TICKETS_DEFAULT 100             /*!< Default tickets. */
+#define TICKETS_MAX 10000               /*!< Most tickets. */
+
+/*! Number of log2 buckets in a scheduler latency histogram. */
+#define SCHED_HIST_BUCKETS 32
+
+/*! Scheduler latency histograms, kept when the kernel is run with
+    "-schedstat".  Bucket I counts intervals of 2**I up to 2**(I+1) CPU
+    cycles, as read from the time stamp counter.  They are allocated apart
+    from the thread, so that they cost nothing without "-schedstat" and
+    never take room from the kernel stack. */
+struct sched_stats {
+    uint32_t ready[SCHED_HIST_BUCKETS];     /*!< From ready to dispatched. */
+    uint32_t slice[SCHED_HIST_BUCKETS];     /*!< From dispatched to switched out. */
+    uint32_t blocked[SCHED_HIST_BUCKETS];   /*!< From blocked to unblocked. */
+    struct list_elem elem;                  /*!< Element in list of spares. */
+};
+
 /*! A kernel thread or user process.
 
    Each thread structure is stored in its own 4 kB page.  The
@@ -102,15 +131,28 @@ struct thread {
     int priority;                       /*!< Priority. */
     int nice;                           /*!< Niceness of thread (mlfqs) */
     struct list_elem allelem;           /*!< List element for all threads list. */
-    int64_t time_to_awake;              /*!< Time remaining for sleep. */
+    int64_t time_to_awake;              /*!< Tick at which to awake from sleep. */
     struct lock *lock_to_acquire;       /*!< Lock attempting to acquire */
-    struct list locks_held;             /*!< List of locks owned */
+    struct heap locks_held;             /*!< Locks owned, by donated priority */
     int64_t recent_cpu;                 /*!< Recent cpu used (mlfqs) */
+    int64_t recent_cpu_stamp;           /*!< Seconds of recent_cpu decay applied (mlfqs) */
+    int tickets;                        /*!< Share of the CPU (stride) */
+    int64_t pass;                       /*!< Virtual time used (stride) */
+    struct heap_elem passelem;          /*!< Run queue heap element (stride) */
+    uint64_t state_stamp;               /*!< Cycle of last state change (schedstat) */
+    struct sched_stats *sched_stats;    /*!< Latency histograms, or NULL (schedstat) */
     /**@}*/
 
     /*! Shared between thread.c and synch.c. */
     /**@{*/
     struct list_elem elem;              /*!< List element. */
+    struct heap_elem waitelem;          /*!< Semaphore waiters heap element. */
+    struct semaphore *waiting_sema;     /*!< Semaphore waited on, if any. */
+    unsigned wait_seq;                  /*!< Arrival order at waiting_sema. */
+    struct heap_elem condelem;          /*!< Condition waiters heap element. */
+    struct condition *waiting_cond;     /*!< Condition waited on, if any. */
+    struct semaphore *cond_sema;        /*!< Upped to signal waiting_cond. */
+    unsigned cond_seq;                  /*!< Arrival order at waiting_cond. */
     /**@}*/
 
 #ifdef USERPROG
@@ -127,13 +169,17 @@ struct thread {
     struct file *executable;            /*!< File pointer to executable. */
     bool child_success;                 /*!< Flag to signal success of child load. */
     struct list_elem childelem;         /*!< List element for all children list. */
+    struct tlb_batch *tlb_batch;        /*!< TLB batch in progress, or NULL. */
     /**@}*/
 #endif
 
     struct list swaps;                  /*!< List of owned swaps. */
-    struct list frames;                 /*!< List of owned frames. */
-    struct list page_entries;           /*!< List of supplemental page entries. */
+    struct list mmaps;                  /*!< List of mapped files. */
+    struct vspace vspace;               /*!< Free user virtual pages. */
     void *stack_bottom;                 /*!< Pointer to the bottom of stack. */
+    void *user_esp;                     /*!< User stack pointer at system call. */
+    uint8_t *fault_around_next;         /*!< Page after last fault-around. */
+    size_t fault_around;                /*!< Pages to map after next fault. */
 
     /*! Owned by thread.c. */
     /**@{*/
@@ -146,10 +192,27 @@ struct thread {
     Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/*! If true, record scheduler latency histograms and print them at
+    shutdown.  Controlled by kernel command-line option "-schedstat". */
+extern bool thread_schedstat;
+
+/*! If true, use the stride scheduler, which shares the CPU between threads
+    in proportion to their tickets.  Controlled by kernel command-line
+    option "-stride". */
+extern bool thread_stride;
+
+/*! Most pages of exited threads kept for reuse by thread_create().
+    Controlled by kernel command-line option "-tcache=COUNT". */
+extern size_t thread_cache_max;
+
+/*! Number of threads created on a page taken from that cache. */
+extern long long thread_cache_hits;
+
 void thread_init(void);
 void thread_start(void);
 
 void thread_tick(void);
+void thread_tick_idle(void);
 void thread_print_stats(void);
 void thread_init_vals(void);
 
@@ -161,12 +224,14 @@ void thread_unblock(struct thread *);
 
 void thread_sleep(int64_t);
 void thread_check_awaken(void);
+int64_t thread_next_awaken(void);
 
 struct thread *thread_current (void);
 tid_t thread_tid(void);
 const char *thread_name(void);
 
 void thread_exit(void) NO_RETURN;
+void thread_free_page(struct thread *);
 void thread_yield(void);
 
 /*! Performs some operation on thread t, given auxiliary data AUX. */
@@ -177,16 +242,15 @@ void thread_foreach(thread_action_func *, void *);
 int thread_get_priority(void);
 void thread_update_priority(void);
 void thread_set_priority(int);
-void thread_lock_set_priority(int, struct thread *);
-
-bool thread_priority_less(const struct list_elem*, const struct list_elem*, void*);
-bool thread_sleep_less(const struct list_elem*, const struct list_elem*, void*);
+void thread_change_priority(struct thread *, int priority);
 
 int thread_get_nice(void);
 void thread_set_nice(int);
 int thread_get_recent_cpu(void);
 void thread_update_recent_cpu(void);
 int thread_get_load_avg(void);
+int thread_get_tickets(void);
+void thread_set_tickets(int);
 void thread_update_load_avg(void);
 
 
@@ -196,10 +260,10 @@ int thread_lock_max_priority (struct thread *t);
 /* Updates the lock that the thread is trying to acquire. */
 void thread_update_lock_to_acquire (struct thread *t, struct lock *l);
 
-/* Adds the passed lock to the list of locks held by the current thread. */
+/* Adds the passed lock to the locks held by the current thread. */
 void thread_acquire_lock (struct lock *l);
 
-/* Removes the passed lock from the list of locks held by the current thread. */
+/* Removes the passed lock from the locks held by the current thread. */
 void thread_release_lock (struct lock *l);
 
 #endif /* threads/thread.h */
@@ -84,4 +84,22 @@ vtop (const void *vaddr)
   return (uintptr_t) vaddr - (uintptr_t) PHYS_BASE;
 }
 
+/* Base and size of the kernel's map of all of physical memory, which
+   the loader caps at 64 MB.  The mapping at PHYS_BASE only covers
+   the memory set up at boot, as the rest of the kernel address space
+   is paged, but every physical address below PHYS_MAP_SIZE appears
+   here, in 4 MB pages at the top of the address space. */
+#define PHYS_MAP ((void *) 0xfc000000)
+#define PHYS_MAP_SIZE (64 * 1024 * 1024)
+
+/* Returns the kernel virtual address at which physical address
+   PADDR appears in the map of physical memory. */
+static inline void *
+pmap (uintptr_t paddr)
+{
+  ASSERT (paddr < PHYS_MAP_SIZE);
+
+  return (uint8_t *) PHYS_MAP + paddr;
+}
+
 #endif /* threads/vaddr.h */
@@ -9,6 +9,7 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "userprog/pagedir.h"
+#include "userprog/process.h"
 #include "userprog/syscall.h"
 #include "vm/falloc.h"
 
@@ -148,19 +149,18 @@ static void page_fault(struct intr_frame *f) {
 
     /* Retrieve the supplementary page entry. */
     struct thread *t = thread_current();
-    uint32_t *pagedir = t->pagedir;
     struct page_entry *pg_entry = palloc_addr_to_page_entry(fault_page);
     
-    /* Special case: handle stack pointer increase. The maximum size increase
-       is 64 bytes, a new page is allocated which will be faulted in the
-       remainder of this function call */
-    if ((pg_entry == NULL) && (t->stack_bottom == fault_addr + 64)) {
-        t->stack_bottom -= PGSIZE;
-        if (NULL == palloc_make_page_addr(t->stack_bottom, PAL_USER | PAL_ZERO, ZERO_PAGE, NULL, NULL)) {
-            kill_current_thread(-1); /* Failed to increase stack */
-        }
-        /* Need to reobtain page_entry to fault stack page in */
-        pg_entry = palloc_addr_to_page_entry(t->stack_bottom);
+    /* Special case: an access in the stack region just below the stack
+       pointer grows the stack down to it.  A fault in the kernel, during a
+       system call, uses the stack pointer saved on entry.  The new pages
+       are brought in together, from the new bottom up to the fault. */
+    if (pg_entry == NULL &&
+        process_grow_stack(fault_addr, user ? f->esp : t->user_esp)) {
+        falloc_get_frames(t->stack_bottom,
+                          palloc_addr_to_page_entry(t->stack_bottom),
+                          (fault_page - t->stack_bottom) / PGSIZE + 1);
+        return;
     }
     
     /* Handle rights violation if page was present, or if no expected at address
@@ -176,20 +176,6 @@ static void page_fault(struct intr_frame *f) {
         }
     }
 
-    /* If in kernel paging entries and not present, check for bad alias, as all
-       paging entries are always pinned */
-    if (!user) {
-        uint32_t ker_pte = *(lookup_page(init_page_dir, fault_page, false));
-        /* Bad alias, set page and try again */
-        if (pte_is_present(ker_pte)) {
-            void *paddr = pagedir_get_page(init_page_dir, fault_page);
-            uint32_t* pte = lookup_page(pagedir, fault_page, true);
-            *pte = ker_pte;
-            pagedir_set_page(pagedir, paddr, fault_page, pte_is_read_write(ker_pte));
-            return;
-        }
-    }
-    
     /* Process expect datas in this address, handle reading it in. */
     falloc_get_frame(fault_page, user || (!user && is_user_vaddr(fault_addr)), pg_entry);
 }
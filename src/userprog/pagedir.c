@@ -7,13 +7,24 @@
 #include "userprog/pagedir.h"
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 
-static uint32_t *active_pd(void);
+/* TLB statistics. */
+static long long tlb_page_cnt;      /*!< Pages invalidated with invlpg. */
+static long long tlb_flush_cnt;     /*!< Whole TLB flushes. */
+static long long tlb_deferred_cnt;  /*!< Invalidations left to a batch. */
+static long long tlb_batch_cnt;     /*!< Batches ended. */
+
+static uintptr_t kernel_page_paddr(const void *kpage);
+static bool pagedir_is_active(uint32_t *);
 static void invalidate_pagedir(uint32_t *);
+static void invalidate_page(uint32_t *, const void *vaddr);
 
 /*! Creates a new page directory that has mappings for kernel virtual
     addresses, but none for user virtual addresses.  Returns the new page
@@ -21,6 +32,8 @@ static void invalidate_pagedir(uint32_t *);
 uint32_t * pagedir_create(void) {
     /* Allocate a page for the page directory, making sure it is pinned. */
     uint32_t *pd = palloc_get_page(PAL_PAGING | PAL_PIN);
+    /* The kernel PDEs of init_page_dir never change after boot, so copying
+       them shares every kernel page table with the new directory. */
     if (pd != NULL)
         memcpy(pd, init_page_dir, PGSIZE);
     return pd;
@@ -34,7 +47,7 @@ void pagedir_destroy(uint32_t *pd) {
         return;
 
     for (pde = pd; pde < pd + pd_no(PHYS_BASE); pde++)
-    if (*pde & PTE_P) {
+    if ((*pde & PTE_P) && !(*pde & PTE_PS)) {
         uint32_t *pt = pde_get_pt(*pde);
         uint32_t *pte;
 
@@ -42,7 +55,9 @@ void pagedir_destroy(uint32_t *pd) {
             if (*pte & PTE_P) 
                 palloc_free_page(pte_get_page(*pte));
         }
-        palloc_free_page(pt);
+        /* PT is the table's address in the map of physical memory; free
+           it by the address it was allocated at. */
+        palloc_free_page(falloc_frame_vaddr((void *) (*pde & PTE_ADDR)));
     }
     palloc_free_page(pd);
 }
@@ -50,10 +65,19 @@ void pagedir_destroy(uint32_t *pd) {
 /*! Returns the address of the page table entry for virtual address VADDR in
     page directory PD.  If PD does not have a page table for VADDR, behavior
     depends on CREATE.  If CREATE is true, then a new page table is created and
-    a pointer into it is returned.  Otherwise, a null pointer is returned. */
+    a pointer into it is returned.  Otherwise, a null pointer is returned.  If
+    VADDR is in a 4 MB page, its PDE is returned, which has the same flags as
+    a PTE. */
 uint32_t * lookup_page(uint32_t *pd, const void *vaddr, bool create) {
     uint32_t *pt, *pde;
 
+    /* Kernel page tables are all made at boot and shared by every page
+       directory, so a kernel address is looked up in init_page_dir,
+       whatever PD, and never needs a new table. */
+    if (is_kernel_vaddr(vaddr)) {
+        pd = init_page_dir;
+        ASSERT(pd[pd_no(vaddr)] & PTE_P);
+    }
     ASSERT(pd != NULL);
 
     /* Check for a page table for VADDR.
@@ -62,17 +86,21 @@ uint32_t * lookup_page(uint32_t *pd, const void *vaddr, bool create) {
     if (*pde == 0)  {
         if (create) {
             /* Allocate a page for the page table entry, making sure it is
-               pinned. */
+               pinned.  Zeroing it brings it into a frame, whose physical
+               address goes in the PDE. */
             pt = palloc_get_page(PAL_PAGING | PAL_ZERO | PAL_PIN);
             if (pt == NULL) 
                 return NULL; 
+            memset(pt, 0, PGSIZE);
 
-            *pde = pde_create(pt);
+            *pde = pde_create((uint32_t *) kernel_page_paddr(pt));
         }
         else {
             return NULL;
         }
     }
+    if (*pde & PTE_PS)
+        return pde;
 
     /* Return the page table entry. */
     pt = pde_get_pt(*pde);
@@ -136,12 +164,45 @@ void * pagedir_get_page(uint32_t *pd, const void *uaddr) {
     uint32_t *pte;
 
     pte = lookup_page(pd, uaddr, false);
-    if (pte != NULL && (*pte & PTE_P) != 0)
+    if (pte != NULL && (*pte & PTE_P) != 0 && (*pte & PTE_PS) != 0)
+        return (void *) (pde_get_large(*pte) +
+                         ((uintptr_t) uaddr & (PTSPAN - 1)));
+    else if (pte != NULL && (*pte & PTE_P) != 0)
         return pte_get_page(*pte) + pg_ofs(uaddr);
     else
         return NULL;
 }
 
+/*! Maps the 4 MB of user virtual memory at UPAGE in PD to the 4 MB page at
+    physical address PPAGE, read/write.  Returns false, mapping nothing, if
+    PD already has a page table there. */
+bool pagedir_set_large(uint32_t *pd, void *upage, uintptr_t ppage) {
+    uint32_t *pde = pd + pd_no(upage);
+
+    ASSERT(((uintptr_t) upage & (PTSPAN - 1)) == 0);
+    ASSERT(is_user_vaddr(upage));
+
+    if (*pde != 0)
+        return false;
+    *pde = pde_create_large(ppage, true);
+    return true;
+}
+
+/*! Unmaps the 4 MB page at UPAGE in PD, mapped by pagedir_set_large(). */
+void pagedir_clear_large(uint32_t *pd, void *upage) {
+    uint32_t *pde = pd + pd_no(upage);
+
+    ASSERT(*pde & PTE_PS);
+    *pde = 0;
+    /* Invalidating any address in a large page drops its TLB entry. */
+    invalidate_page(pd, upage);
+}
+
+/*! Returns true if VADDR is in a 4 MB page of PD. */
+bool pagedir_is_large(uint32_t *pd, const void *vaddr) {
+    return (pd[pd_no(vaddr)] & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS);
+}
+
 /*! Marks user virtual page UPAGE "not present" in page directory PD.  Later
     accesses to the page will fault.  Other bits in the page table entry are
     preserved. The pinned bit is also reset to mark as unpinned.
@@ -155,7 +216,7 @@ void pagedir_clear_page(uint32_t *pd, void *upage) {
     pte = lookup_page(pd, upage, false);
     if (pte != NULL && (*pte & PTE_P) != 0) {
         *pte &= ~(PTE_P | PTE_PIN);
-        invalidate_pagedir(pd);
+        invalidate_page(pd, upage);
     }
 }
 
@@ -176,7 +237,7 @@ void pagedir_set_dirty(uint32_t *pd, const void *vpage, bool dirty) {
         }
         else {
             *pte &= ~(uint32_t) PTE_D;
-            invalidate_pagedir(pd);
+            invalidate_page(pd, vpage);
         }
     }
 }
@@ -199,7 +260,7 @@ void pagedir_set_accessed(uint32_t *pd, const void *vpage, bool accessed) {
         }
         else {
             *pte &= ~(uint32_t) PTE_A; 
-            invalidate_pagedir(pd);
+            invalidate_page(pd, vpage);
         }
     }
 }
@@ -213,17 +274,28 @@ void pagedir_activate(uint32_t *pd) {
        (page directory base register).  This activates our new page tables
        immediately.  See [IA32-v2a] "MOV--Move to/from Control Registers" and
        [IA32-v3a] 3.7.5 "Base Address of the Page Directory". */
-    asm volatile ("movl %0, %%cr3" : : "r" (vtop (pd)) : "memory");
+    asm volatile ("movl %0, %%cr3" : : "r" (kernel_page_paddr(pd))
+                  : "memory");
 }
 
-/*! Returns the currently active page directory. */
-static uint32_t * active_pd(void) {
-    /* Copy CR3, the page directory base register (PDBR), into `pd'.
+/*! Returns the physical address of kernel page KPAGE, which must be in a
+    frame.  Only pages set up at boot are at their physical address plus
+    PHYS_BASE. */
+static uintptr_t kernel_page_paddr(const void *kpage) {
+    uint32_t *pte = lookup_page(init_page_dir, kpage, false);
+
+    ASSERT(pte != NULL && (*pte & PTE_P));
+    return *pte & PTE_ADDR;
+}
+
+/*! Returns true if PD is the currently active page directory. */
+static bool pagedir_is_active(uint32_t *pd) {
+    /* Copy CR3, the page directory base register (PDBR), into `cr3'.
        See [IA32-v2a] "MOV--Move to/from Control Registers" and
        [IA32-v3a] 3.7.5 "Base Address of the Page Directory". */
-    uintptr_t pd;
-    asm volatile ("movl %%cr3, %0" : "=r" (pd));
-    return ptov(pd);
+    uintptr_t cr3;
+    asm volatile ("movl %%cr3, %0" : "=r" (cr3));
+    return pd != NULL && cr3 == kernel_page_paddr(pd);
 }
 
 /*! Some page table changes can cause the CPU's translation lookaside buffer
@@ -234,10 +306,84 @@ static uint32_t * active_pd(void) {
     (If PD is not active then its entries are not in the TLB, so there is no
     need to invalidate anything.) */
 static void invalidate_pagedir(uint32_t *pd) {
-    if (active_pd() == pd) {
+    if (pagedir_is_active(pd)) {
         /* Re-activating PD clears the TLB.  See [IA32-v3a] 3.12
            "Translation Lookaside Buffers (TLBs)". */
         pagedir_activate(pd);
+        tlb_flush_cnt++;
     }
 }
 
+/*! Invalidates the TLB entry of virtual page VADDR of PD, if it may be in
+    the TLB: if VADDR is a kernel page, whose page tables every page
+    directory shares, or PD is the active page directory.  If the running
+    thread has a batch in progress for PD, the page is only recorded in
+    it. */
+static void invalidate_page(uint32_t *pd, const void *vaddr) {
+    struct tlb_batch *b = thread_current()->tlb_batch;
+
+    if (b != NULL && b->pd == pd && is_user_vaddr(vaddr)) {
+        if (b->cnt < TLB_BATCH_MAX)
+            b->pages[b->cnt] = vaddr;
+        b->cnt++;
+        tlb_deferred_cnt++;
+    }
+    else if (is_kernel_vaddr(vaddr) || pagedir_is_active(pd)) {
+        tlb_invalidate_page(vaddr);
+    }
+}
+
+/*! Invalidates the TLB entry of virtual page VADDR in the active page
+    directory.  See [IA32-v2a] "INVLPG--Invalidate TLB Entry". */
+void tlb_invalidate_page(const void *vaddr) {
+    asm volatile ("invlpg (%0)" : : "r" (vaddr) : "memory");
+    tlb_page_cnt++;
+}
+
+/*! Begins batch B of TLB invalidations for the user pages of page
+    directory PD.  Until pagedir_batch_end(), pages of PD that the running
+    thread unmaps or whose accessed or dirty bits it clears are only
+    recorded in B, so the thread must not touch them in the meantime.
+    Other threads are not affected: switching to them reloads CR3.  A
+    batch begun while another is in progress leaves the recording to the
+    outer batch. */
+void pagedir_batch_begin(struct tlb_batch *b, uint32_t *pd) {
+    struct thread *t = thread_current();
+
+    b->pd = pd;
+    b->cnt = 0;
+    b->outer = t->tlb_batch;
+    if (b->outer == NULL)
+        t->tlb_batch = b;
+}
+
+/*! Ends batch B, invalidating the pages recorded one at a time if there
+    are at most TLB_BATCH_MAX of them, or else flushing the whole TLB. */
+void pagedir_batch_end(struct tlb_batch *b) {
+    struct thread *t = thread_current();
+    size_t i;
+
+    if (b->outer != NULL)
+        return;
+    ASSERT(t->tlb_batch == b);
+    t->tlb_batch = NULL;
+    tlb_batch_cnt++;
+
+    if (b->cnt == 0 || !pagedir_is_active(b->pd))
+        return;
+    if (b->cnt > TLB_BATCH_MAX) {
+        invalidate_pagedir(b->pd);
+    }
+    else {
+        for (i = 0; i < b->cnt; i++)
+            tlb_invalidate_page(b->pages[i]);
+    }
+}
+
+/*! Prints TLB statistics. */
+void pagedir_print_stats(void) {
+    printf("TLB: %lld pages invalidated, %lld full flushes, "
+           "%lld invalidations batched in %lld batches\n",
+           tlb_page_cnt, tlb_flush_cnt, tlb_deferred_cnt, tlb_batch_cnt);
+}
+
@@ -2,20 +2,41 @@
 #define USERPROG_PAGEDIR_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+/*! Most pages a TLB batch invalidates one at a time.  A batch with more
+    flushes the whole TLB instead. */
+#define TLB_BATCH_MAX 32
+
+/*! Pages of one page directory whose TLB entries are stale, collected so
+    that a bulk operation flushes them once at its end. */
+struct tlb_batch {
+    uint32_t *pd;                       /*!< Page directory changed. */
+    size_t cnt;                         /*!< Pages recorded, even past max. */
+    const void *pages[TLB_BATCH_MAX];   /*!< The first pages recorded. */
+    struct tlb_batch *outer;            /*!< Batch already in progress. */
+};
+
 uint32_t *pagedir_create(void);
 void pagedir_destroy(uint32_t *pd);
 bool pagedir_set_page(uint32_t *pd, void *upage, void *kpage, bool rw);
 bool pagedir_set_page_kernel(uint32_t *pd, void *upage, void *kpage, bool rw);
 void *pagedir_get_page(uint32_t *pd, const void *upage);
 void pagedir_clear_page(uint32_t *pd, void *upage);
+bool pagedir_set_large(uint32_t *pd, void *upage, uintptr_t ppage);
+void pagedir_clear_large(uint32_t *pd, void *upage);
+bool pagedir_is_large(uint32_t *pd, const void *vaddr);
 bool pagedir_is_dirty(uint32_t *pd, const void *upage);
 void pagedir_set_dirty(uint32_t *pd, const void *upage, bool dirty);
 bool pagedir_is_accessed(uint32_t *pd, const void *upage);
 void pagedir_set_accessed(uint32_t *pd, const void *upage, bool accessed);
 void pagedir_activate(uint32_t *pd);
 uint32_t * lookup_page(uint32_t *pd, const void *vaddr, bool create);
+void pagedir_batch_begin(struct tlb_batch *, uint32_t *pd);
+void pagedir_batch_end(struct tlb_batch *);
+void tlb_invalidate_page(const void *vaddr);
+void pagedir_print_stats(void);
 
 #endif /* userprog/pagedir.h */
 
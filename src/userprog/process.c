@@ -1,4 +1,5 @@
 #include "userprog/process.h"
+#include <ctype.h>
 #include <debug.h>
 #include <inttypes.h>
 #include <round.h>
@@ -17,6 +18,30 @@
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "vm/mmap.h"
+#include "vm/swalloc.h"
+
+/*! Extra pages mapped below the faulting address when the stack grows, so
+    that the pushes that follow do not fault again. */
+#define STACK_GROW_AHEAD 3
+
+size_t process_stack_pages = STACK_DEFAULT_PAGES;
+
+/*! Sets process_stack_pages from VALUE, as given to "-stack", which must be
+    a page count from 1 to STACK_MAX_PAGES. */
+void process_set_stack_pages(const char *value) {
+    const char *p;
+
+    if (value == NULL || *value == '\0')
+        PANIC("-stack needs a value");
+    for (p = value; *p != '\0'; p++) {
+        if (!isdigit(*p))
+            PANIC("-stack value `%s' is not a page count", value);
+    }
+    if (strlen(value) > 7 || atoi(value) < 1 || atoi(value) > STACK_MAX_PAGES)
+        PANIC("-stack value %s is outside 1..%d", value, STACK_MAX_PAGES);
+    process_stack_pages = atoi(value);
+}
 
 static thread_func start_process NO_RETURN;
 static bool load(const char *cmdline, void (**eip)(void), void **esp);
@@ -193,7 +218,7 @@ int process_wait(tid_t child_tid) {
 
     /* Destroy thread here as scheduler wont see it as prev. */
     list_remove(&(thread_waited_on->childelem));
-    palloc_free_page(thread_waited_on);
+    thread_free_page(thread_waited_on);
 
     return status;
 }
@@ -203,27 +228,44 @@ void process_exit(void) {
     struct thread *cur = thread_current();
     uint32_t *pd;
     struct list_elem *e;
+    struct tlb_batch batch;
+    uintptr_t page = 0;
+    size_t cnt;
 
     /* Clean up all frames and pages, and related data. */
-    /* Things to clean up in thread struct
-            - supplemental page entries (t->page_entries)
-            - free all frames
-            - free all pages
-     */
-
-    /* Free all the frames in the process. */
-    while (!list_empty(&(cur->frames))) {
-        e = list_front(&(cur->frames));
-        struct frame *frame_e = list_entry(e, struct frame, process_elem);
-        falloc_free_frame(frame_e->faddr);
+
+    /* Unmapping every page one at a time would invalidate the TLB for
+       each; collect them and flush once instead. */
+    pagedir_batch_begin(&batch, cur->pagedir);
+
+    /* Unmap mapped files first, writing their dirty pages back while the
+       files are still open. */
+    mmap_unmap_all();
+
+    /* Free all the pages in the process, and their frames.  They are
+       found as the used runs of its address space.  A thread that never
+       ran a process has none. */
+    if (cur->pagedir != NULL) {
+        while ((cnt = vspace_used_run(&(cur->vspace), &page,
+                                      pg_no(PHYS_BASE))) > 0) {
+            for (; cnt > 0; cnt--, page++) {
+                void *upage = (void *) (page << PGBITS);
+                struct page_entry *page_e = palloc_page_lookup(cur, upage);
+                if (page_e != NULL) {
+                    falloc_free_page(page_e);
+                    palloc_free_page(upage);
+                }
+            }
+        }
     }
-    
-    /* Free all the pages in the process. */
-    while (!list_empty(&(cur->page_entries))) {
-        e = list_front(&(cur->page_entries));
-        struct page_entry *page_e = list_entry(e, struct page_entry, elem);
-        palloc_free_page(page_e->vaddr);
+    vspace_destroy(&(cur->vspace));
+
+    /* Free any swap slots left over, which freeing the pages did not. */
+    while (!list_empty(&(cur->swaps))) {
+        e = list_front(&(cur->swaps));
+        swalloc_free_swap(list_entry(e, struct swap, process_elem));
     }
+    pagedir_batch_end(&batch);
     
     /* Destroy the current process's page directory and switch back
        to the kernel-only page directory. */
@@ -339,6 +381,8 @@ bool load(const char *file_name, void (**eip) (void), void **esp) {
     t->pagedir = pagedir_create();
     if (t->pagedir == NULL)
         goto done;
+    if (!vspace_create(&(t->vspace), 1, pg_no(PHYS_BASE) - 1))
+        goto done;
     process_activate();
 
     /* Open executable file. */
@@ -502,7 +546,8 @@ static bool load_segment(struct file *file, off_t ofs, uint8_t *upage,
     
     enum palloc_flags flags = PAL_USER;
     if (!writable) {
-        flags |= PAL_READO;
+        /* Read-only pages are the same in every process running the file. */
+        flags |= PAL_READO | PAL_SHARE;
     }
     /* If allocation of pages fails, load fails. */
     if (NULL == palloc_make_multiple_addr(upage, flags, 
@@ -518,12 +563,56 @@ static bool load_segment(struct file *file, off_t ofs, uint8_t *upage,
 }
 
 /*! Create a minimal stack by mapping a zeroed page at the top of
-    user virtual memory. */
+    user virtual memory.  The rest of the stack region is taken out of the
+    free address space, so that only stack growth maps pages there. */
 static bool setup_stack(void **esp) {
+    struct thread *t = thread_current();
 
     if (NULL == palloc_make_page_addr(PHYS_BASE - PGSIZE, PAL_USER | PAL_ZERO, ZERO_PAGE, NULL, NULL)) {
         return false;
     }
+    if (process_stack_pages > 1 &&
+        !vspace_take(&(t->vspace), pg_no(PHYS_BASE) - process_stack_pages,
+                     process_stack_pages - 1)) {
+        return false;
+    }
+    t->stack_bottom = PHYS_BASE - PGSIZE;
     *esp = PHYS_BASE;
     return true;
 }
+
+/*! Grows the stack of the current process down to cover FAULT_ADDR, if it
+    lies in the reserved stack region below the current bottom and no more
+    than 32 bytes below ESP, the user stack pointer (PUSHA writes 32 bytes
+    below it before moving it).  The stack is extended in one step, with
+    STACK_GROW_AHEAD more pages if the region has room.  Returns true if
+    the stack now covers FAULT_ADDR. */
+bool process_grow_stack(void *fault_addr, void *esp) {
+    struct thread *t = thread_current();
+    uintptr_t limit = pg_no(PHYS_BASE) - process_stack_pages;
+    uintptr_t bottom = pg_no(t->stack_bottom);
+    uintptr_t page = pg_no(fault_addr);
+    uintptr_t new_bottom;
+
+    if (t->pagedir == NULL || !is_user_vaddr(fault_addr) ||
+        page < limit || page >= bottom ||
+        (uint8_t *) fault_addr + 32 < (uint8_t *) esp) {
+        return false;
+    }
+    new_bottom = page - limit > STACK_GROW_AHEAD ? page - STACK_GROW_AHEAD
+                                                 : limit;
+
+    /* Hand the pages back to the address space, then map them. */
+    if (!vspace_give(&(t->vspace), new_bottom, bottom - new_bottom)) {
+        return false;
+    }
+    if (NULL == palloc_make_multiple_addr((void *) (new_bottom << PGBITS),
+                                          PAL_USER | PAL_ZERO,
+                                          bottom - new_bottom, ZERO_PAGE,
+                                          NULL, NULL)) {
+        vspace_take(&(t->vspace), new_bottom, bottom - new_bottom);
+        return false;
+    }
+    t->stack_bottom = (void *) (new_bottom << PGBITS);
+    return true;
+}
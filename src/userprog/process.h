@@ -3,10 +3,23 @@
 
 #include "threads/thread.h"
 
+/*! Default size of the region reserved for each user stack, 8 MB. */
+#define STACK_DEFAULT_PAGES 2048
+
+/*! Largest region that may be reserved for a user stack, 2 GB, which leaves
+    the lowest 1 GB of user memory for code, data and mappings. */
+#define STACK_MAX_PAGES 524288
+
+/*! Pages reserved for each user stack, which may grow down to fill them.
+    Controlled by kernel command-line option "-stack=COUNT". */
+extern size_t process_stack_pages;
+
 tid_t process_execute(const char *file_name);
 int process_wait(tid_t);
 void process_exit(void);
 void process_activate(void);
+bool process_grow_stack(void *fault_addr, void *esp);
+void process_set_stack_pages(const char *value);
 
 #endif /* userprog/process.h */
 
@@ -7,14 +7,18 @@
 #include "threads/thread.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "threads/pte.h"
 #include "threads/malloc.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
+#include "vm/mmap.h"
 #include "process.h"
+#include "userprog/pagedir.h"
 
 #define INVALID_FILE_ID -1      // File identifier for an invalid file.
 
 static void syscall_handler(struct intr_frame *);
+static bool buffer_is_writable(void *buffer, unsigned size);
 
 // Prototypes for system call functions
 void syscall_halt    (struct intr_frame *, void * arg1, void * arg2, void * arg3);
@@ -37,6 +41,9 @@ void syscall_mkdir   (struct intr_frame *, void * arg1, void * arg2, void * arg3
 void syscall_readdir (struct intr_frame *, void * arg1, void * arg2, void * arg3);
 void syscall_isdir   (struct intr_frame *, void * arg1, void * arg2, void * arg3);
 void syscall_inumber (struct intr_frame *, void * arg1, void * arg2, void * arg3);
+void syscall_settickets(struct intr_frame *, void * arg1, void * arg2, void * arg3);
+void syscall_gettickets(struct intr_frame *, void * arg1, void * arg2, void * arg3);
+void syscall_mmap_anon(struct intr_frame *, void * arg1, void * arg2, void * arg3);
 
 // Table of function pointers for system calls. The order here must match the
 // order of constants in the enum declaration in syscall-nr.h exactly.
@@ -44,10 +51,11 @@ static void (*syscall_table[])(struct intr_frame *, void *, void *, void *) = {s
     syscall_exec, syscall_wait, syscall_create, syscall_remove, syscall_open,
     syscall_filesize, syscall_read, syscall_write, syscall_seek, syscall_tell,
     syscall_close, syscall_mmap, syscall_munmap, syscall_chdir, syscall_mkdir,
-    syscall_readdir, syscall_isdir, syscall_inumber};
+    syscall_readdir, syscall_isdir, syscall_inumber, syscall_settickets,
+    syscall_gettickets, syscall_mmap_anon};
 // Argument number for each system call. Again, order must match exactly
-static uint32_t syscall_num_arg[] = {0, 1, 1, 1, 2, 1, 1, 1, 3, 3, 2, 1, 1, 2, 1, 1, 1, 2, 1, 1};
-static uint32_t num_syscalls = 20;
+static uint32_t syscall_num_arg[] = {0, 1, 1, 1, 2, 1, 1, 1, 3, 3, 2, 1, 1, 2, 1, 1, 1, 2, 1, 1, 1, 0, 3};
+static uint32_t num_syscalls = 23;
 
 void syscall_init(void)
 {
@@ -58,6 +66,8 @@ static void syscall_handler(struct intr_frame *f)
 {
     // Turn interrupts back on during system call
     intr_enable();
+    // Save the user stack pointer, for page faults in user memory
+    thread_current()->user_esp = f->esp;
     // Get the system call number
     uint32_t num = *((uint32_t*)(f->esp));
     // Call appropriate system handler
@@ -98,6 +108,26 @@ void kill_current_thread(int status) {
     thread_exit();
 }
 
+// Returns false if any page of the passed buffer is mapped read-only.  The
+// kernel can write to read-only user pages, and read-only pages of an
+// executable are shared with every process running it.
+static bool buffer_is_writable(void *buffer, unsigned size)
+{
+    uint32_t *pd = thread_current()->pagedir;
+    uint8_t *page;
+
+    for (page = pg_round_down(buffer); page < (uint8_t *) buffer + size;
+         page += PGSIZE)
+    {
+        uint32_t *pte = lookup_page(pd, page, false);
+        if (pte != NULL && *pte != 0 && !pte_is_read_write(*pte))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 // Halts the system and shuts it down.
 void syscall_halt(struct intr_frame *f UNUSED, void * arg1 UNUSED, void * arg2 UNUSED, void * arg3 UNUSED)
 {
@@ -269,8 +299,9 @@ void syscall_read(struct intr_frame *f, void * arg1, void * arg2, void * arg3)
     struct file *file_to_access;
     struct thread *t = thread_current();
     
-    // If the entire buffer is not in user space, terminate.
-    if (!is_user_vaddr(buffer + size - 1))
+    // If the entire buffer is not in user space, or cannot be written,
+    // terminate.
+    if (!is_user_vaddr(buffer + size - 1) || !buffer_is_writable(buffer, size))
     {
         kill_current_thread(-1);
     }
@@ -444,16 +475,24 @@ void syscall_close(struct intr_frame *f UNUSED, void * arg1, void * arg2 UNUSED,
     }
 }
 
-// TODO - Project 3
-void syscall_mmap(struct intr_frame *f UNUSED, void * arg1 UNUSED, void * arg2 UNUSED, void * arg3 UNUSED)
+// Maps the file open as fd into memory starting at the page addr.  Returns the
+// mapping id, or -1 if the file cannot be mapped there.
+void syscall_mmap(struct intr_frame *f, void * arg1, void * arg2, void * arg3 UNUSED)
 {
-    // TODO
+    // Reconstruct arguments.
+    int fd = (int) arg1;
+    void *addr = arg2;
+    struct thread *t = thread_current();
+
+    // Console file descriptors and invalid ones give NULL, which fails.
+    f->eax = (uint32_t) mmap_map(file_fid_to_f(fd, &(t->files_opened)), addr);
 }
 
-// TODO - Project 3
-void syscall_munmap(struct intr_frame *f UNUSED, void * arg1 UNUSED, void * arg2 UNUSED, void * arg3 UNUSED)
+// Unmaps the mapping with the passed id, writing its dirty pages back to the
+// file.  Unknown ids are ignored.
+void syscall_munmap(struct intr_frame *f UNUSED, void * arg1, void * arg2 UNUSED, void * arg3 UNUSED)
 {
-    // TODO
+    mmap_unmap((mapid_t) arg1);
 }
 
 // TODO - Project 4
@@ -486,3 +525,39 @@ void syscall_inumber(struct intr_frame *f UNUSED, void * arg1 UNUSED, void * arg
 {
     // TODO
 }
+
+// Sets the stride scheduler tickets of the process, returning false if the
+// count is out of range.
+void syscall_settickets(struct intr_frame *f, void * arg1, void * arg2 UNUSED, void * arg3 UNUSED)
+{
+    int tickets = (int) arg1;
+
+    if (tickets < TICKETS_MIN || tickets > TICKETS_MAX)
+    {
+        f->eax = (uint32_t) false;
+    }
+    else
+    {
+        thread_set_tickets(tickets);
+        f->eax = (uint32_t) true;
+    }
+}
+
+// Returns the stride scheduler tickets of the process.
+void syscall_gettickets(struct intr_frame *f, void * arg1 UNUSED, void * arg2 UNUSED, void * arg3 UNUSED)
+{
+    f->eax = (uint32_t) thread_get_tickets();
+}
+
+// Maps size bytes of zeroed memory starting at the page addr, with 4 MB pages
+// where possible if flags has MAP_LARGE.  Returns the mapping id, or -1 if the
+// memory cannot be mapped there.
+void syscall_mmap_anon(struct intr_frame *f, void * arg1, void * arg2, void * arg3)
+{
+    // Reconstruct arguments.
+    void *addr = arg1;
+    unsigned size = (unsigned) arg2;
+    int flags = (int) arg3;
+
+    f->eax = (uint32_t) mmap_map_anon(addr, size, flags);
+}
@@ -22,23 +22,101 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "vm/share.h"
+#include "vm/slab.h"
 #include "vm/swalloc.h"
+#include "vm/vspace.h"
+#include "devices/timer.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
 
-#define NUM_PAGE_ENTRY  6000
+/*! Pages set aside at boot as the first slabs of page entries.  Later
+    slabs are allocated as page entries run low. */
+#define SLAB_BOOT_PAGES 2
+
+/*! Shared executable pages.  Once they run out, further read-only pages
+    are private to their process. */
+#define NUM_SHARE       1024
+
+/*! WSClock working-set window in timer ticks.  Pages unused for longer are
+    outside the working set and may be evicted. */
+#define WSCLOCK_TAU     (TIMER_FREQ / 2)
+
+/*! Pages in frame_window, enough for a cluster of swap slots. */
+#define FRAME_WINDOW_PAGES SWAP_CLUSTER
+
+/*! Most dirty pages the pageout thread cleans each time it is woken. */
+#define PAGEOUT_CLEAN_MAX SWAP_CLUSTER
+
+/*! Most pages mapped after a faulting page by fault-around. */
+#define FAULT_AROUND_MAX 16
+
+/*! Most free frames of each pool kept zeroed by the zeroing thread. */
+#define ZEROED_MAX      64
+
+/*! CR4 bits that enable 4 MB pages and keep global pages in the TLB
+    across CR3 loads. */
+#define CR4_PSE         0x00000010
+#define CR4_PGE         0x00000080
+
+/*! Frames in a 4 MB page. */
+#define LARGE_FRAMES    (PTSPAN / PGSIZE)
+
+/*! Frame number ending a free list. */
+#define FRAME_NONE      UINT32_MAX
+
+/*! A list of free frames, linked through their frame numbers. */
+struct free_list {
+    uint32_t head;                  /*!< First frame number, or FRAME_NONE. */
+    uint32_t tail;                  /*!< Last frame number, or FRAME_NONE. */
+};
 
 static struct frame *addr_to_frame(void *frame_addr);
+static struct frame *page_frame(struct page_entry *);
+static uint32_t *frame_pte(struct frame *);
+static void *frame_map(struct frame *);
+static void *frame_map_multiple(struct frame **, size_t cnt);
+static void frame_unmap(void);
+static uint32_t *frame_install(uint32_t *pd, void *upage, void *frame,
+                               bool user);
+static void frame_associate(struct frame *, struct page_entry *);
+static void frame_swap_in(struct frame *, struct swap *);
+static void frame_free(struct frame *);
+static void frame_writeback(struct frame *);
+static void frame_io_begin(struct frame *);
+static void frame_io_end(struct frame *);
+static bool fs_acquire(void);
+static void fs_release(bool acquired);
+static void *frame_share_in(struct page_entry *);
+static size_t frame_around_window(void *upage);
+static void *frame_fault_around(void *upage, struct page_entry *,
+                                size_t around);
+static struct page_entry *frame_around_page(struct page_entry *, size_t i);
+static void frame_share_map(struct frame *, struct page_entry *);
+static void frame_share_release(struct frame *);
+static struct frame *frame_get(bool user, bool zero, bool *zeroed);
+static struct frame *frame_take_free(bool user, bool zero, bool *zeroed);
+static struct frame *frame_take_large(void);
+static void frame_put_free(struct frame *, bool user);
+static void free_list_init(struct free_list *);
+static bool free_list_empty(const struct free_list *);
+static void free_list_push_back(struct free_list *, struct frame *);
+static struct frame *free_list_pop_front(struct free_list *);
+static void free_list_remove(struct free_list *, struct frame *);
+static void pageout(void *aux);
+static void zeroer(void *aux);
 
-static struct list *open_frame_list_user;
-static struct list *open_frame_list_kernel;
+static struct free_list open_frame_list_user;
+static struct free_list open_frame_list_kernel;
 
 static struct frame *frame_list_user;
 static struct frame *frame_list_kernel;
@@ -46,27 +124,125 @@ static struct frame *frame_list_kernel;
 static uint32_t user_frames;
 static uint32_t kernel_frames;
 
-static struct list *open_page_entry;
+/*! Free frames that have been zeroed, and how many are on each list.  The
+    zeroing thread fills them from the open lists while the CPU is idle. */
+static struct free_list zeroed_frame_list_user;
+static struct free_list zeroed_frame_list_kernel;
+static size_t zeroed_user_cnt;
+static size_t zeroed_kernel_cnt;
+
+/*! Signaled, with the frame lock held, when a frame is freed. */
+static struct condition zero_cond;
+
+/*! Frames on open_frame_list_user and zeroed_frame_list_user. */
+static uint32_t user_free_cnt;
+
+/*! Free user frame watermarks.  The pageout thread is woken when fewer
+    than falloc_low_water frames are free, and evicts until
+    falloc_high_water are.  Set by -pageout, or by falloc_init() if not. */
+static uint32_t falloc_low_water;
+static uint32_t falloc_high_water;
+static bool watermarks_set;
+
+/*! Signaled, with the frame lock held, when free user frames run low. */
+static struct condition pageout_cond;
+
+/*! Clock hand of the pageout thread's cleaning, an index into
+    frame_list_user. */
+static uint32_t clean_hand;
+
+/*! Page entries of the pages mapped by falloc_init(), which are never
+    freed, and the cache from which all others are allocated. */
+static struct page_entry *boot_page_entry;
+static size_t boot_page_entry_cnt;
+static struct slab_cache page_entry_cache;
 
-void frame_evict(bool user);
+/*! Serializes frame allocation, freeing and eviction.  It is never held
+    across a disk transfer: the frame is marked FRAME_IO instead, and the
+    lock is dropped for the transfer.  The file system lock, when needed,
+    is taken before it, never while it is held. */
+static struct lock frame_lock;
+
+/*! Signaled, with the frame lock held, when a frame's transfer ends, and
+    the number of frames in transfer. */
+static struct condition frame_io_cond;
+static size_t frame_io_cnt;
+
+/*! Kernel pages through which runs of frames are reached one after
+    another, for transfers of several pages at once, their page table
+    entries, and how many of them are mapped.  The window is used with the
+    frame lock released, so it has its own lock, taken after that one is
+    dropped. */
+static struct lock window_lock;
+static uint8_t *frame_window;
+static uint32_t *frame_window_pte[FRAME_WINDOW_PAGES];
+static size_t frame_window_cnt;
+
+/*! Serializes reading shared pages in, so that each is read only once. */
+static struct lock share_lock;
+
+/*! Replacement policy used by frame_evict(). */
+enum falloc_policy falloc_policy = FALLOC_CLOCK;
+
+/*! Names of the replacement policies, indexed by enum falloc_policy. */
+static const char *policy_names[] = {"clock", "aging", "wsclock"};
+
+/*! Clock hand, an index into frame_list_user. */
+static uint32_t clock_hand;
+
+/* Eviction statistics. */
+static long long evict_cnt;         /*!< Frames evicted. */
+static long long evict_swap_cnt;    /*!< Evicted pages written to swap. */
+static long long evict_drop_cnt;    /*!< Clean evicted pages dropped. */
+static long long evict_file_cnt;    /*!< Evicted pages written to file. */
+static long long evict_write_cnt;   /*!< Swap writes, one per cluster. */
+static long long swap_ahead_cnt;    /*!< Pages read ahead from swap. */
+
+/* Reclaim statistics. */
+static long long direct_reclaim_cnt;    /*!< Evictions by faulting threads. */
+static long long pageout_reclaim_cnt;   /*!< Evictions by pageout thread. */
+static long long pageout_clean_cnt;     /*!< Dirty pages cleaned. */
+
+/* Sharing statistics. */
+static long long share_read_cnt;    /*!< Shared pages read from files. */
+static long long share_map_cnt;     /*!< Shared pages mapped without a read. */
+
+/*! Pages mapped by fault-around, each a fault avoided. */
+static long long fault_around_cnt;
+
+/* Zeroing statistics. */
+static long long zero_fill_cnt;     /*!< Zero-fill faults. */
+static long long prezeroed_cnt;     /*!< Zero-fills served pre-zeroed. */
+static long long zeroed_cnt;        /*!< Frames zeroed by zeroing thread. */
+
+/* 4 MB user page statistics. */
+static long long large_cnt;         /*!< 4 MB pages mapped. */
+static long long large_fail_cnt;    /*!< Requests with no run of frames. */
+
+bool frame_evict(bool user);
 
 /*! Returns a supplementary page entry for an open page.  Note that this
-    function will panic if there are no open pages. */
+    function will panic if no kernel page is left to allocate it from. */
 struct page_entry *get_page_entry(void)
 {
-    if (list_empty(open_page_entry))
+    struct page_entry *entry = slab_alloc(&page_entry_cache);
+
+    if (entry == NULL)
     {
         PANIC("get_page_entry: out of page entries to allocate");
     }
-    /* Otherwise, get an open page entry. */
-    struct list_elem *elem = list_pop_front(open_page_entry);
-    return list_entry(elem, struct page_entry, elem);
+    return entry;
 }
 
-/*! Frees a page entry by putting it back into the open list. */
+/*! Frees a page entry by giving it back to its cache. */
 void free_page_entry(struct page_entry *entry)
 {
-    list_push_back(open_page_entry, &(entry->elem));
+    if (boot_page_entry <= entry &&
+        entry < boot_page_entry + boot_page_entry_cnt)
+    {
+        return;
+    }
+    slab_free(&page_entry_cache, entry);
 }
 
 /*! Initializes the frame allocator.  At most USER_FRAME_LIMIT frames are put
@@ -76,6 +252,11 @@ void falloc_init(size_t user_frame_limit)
     uint32_t *pd, *pt;
     size_t page;
     uint32_t i;
+    uint32_t window_page;
+    uint32_t num_boot_page;
+    void *slab_pages, *vspace_pages;
+    size_t kernel_pages;
+    uint32_t cr4;
     extern char _start, _end_kernel_text;
 
     /* Free memory starts at 1 MB and runs to the end of RAM. */
@@ -96,64 +277,123 @@ void falloc_init(size_t user_frame_limit)
     frame_list_user   = (struct frame *) (1024 * 1024 + sizeof(struct frame) * (kernel_frames));
     uint32_t num_frame_used = 1024 * 1024 + sizeof(struct frame) * (user_frames + kernel_frames);
     num_frame_used = (uint32_t) pg_round_up((void *) num_frame_used) / PGSIZE;
-    /* Compute space for page_entry structs */
-    uint32_t num_frame_for_page_ent = (sizeof(struct page_entry) * NUM_PAGE_ENTRY / PGSIZE) + 1;
+    /* Compute space for the supplemental page table's buckets, as many as
+       RAM can fill */
+    size_t page_hash_bucket_cnt = PAGE_HASH_MIN;
+    while (page_hash_bucket_cnt * PAGE_HASH_LOAD < init_ram_pages)
+    {
+        page_hash_bucket_cnt *= 2;
+    }
+    uint32_t num_frame_for_page_hash = (sizeof(struct page_entry *) * page_hash_bucket_cnt - 1) / PGSIZE + 1;
+    /* Compute space for the shared pages and their table's buckets */
+    uint32_t num_frame_for_share = (sizeof(struct share) * NUM_SHARE +
+                                    sizeof(struct list) * SHARE_HASH_BUCKETS - 1) / PGSIZE + 1;
+    /* The kernel address space runs from PHYS_BASE for twice as many pages
+       as there are of RAM, or up to the map of physical memory.  All of its
+       page tables are made here, so that every page directory shares them
+       and a kernel page mapped in one is mapped in all. */
+    ASSERT(init_ram_pages <= PHYS_MAP_SIZE / PGSIZE);
+    kernel_pages = ROUND_UP(2 * init_ram_pages, (size_t) 1 << PTBITS);
+    if (kernel_pages > pg_no(PHYS_MAP) - pg_no(PHYS_BASE))
+    {
+        kernel_pages = pg_no(PHYS_MAP) - pg_no(PHYS_BASE);
+    }
+    uint32_t num_frame_for_kernel_pt = kernel_pages >> PTBITS;
+    /* Compute space for the page_entry structs of every page mapped here:
+       those set aside above and below, the page directory, and these page
+       entries. */
+    num_boot_page = num_frame_used + num_frame_for_page_hash +
+                    SLAB_BOOT_PAGES + num_frame_for_share +
+                    num_frame_for_kernel_pt + FRAME_WINDOW_PAGES +
+                    SLAB_BOOT_PAGES + 1;
+    uint32_t num_frame_for_page_ent = 0;
+    do
+    {
+        num_frame_for_page_ent++;
+        boot_page_entry_cnt = num_frame_for_page_ent * PGSIZE / sizeof(struct page_entry);
+    }
+    while (boot_page_entry_cnt < num_boot_page + num_frame_for_page_ent);
     struct page_entry *page_entry_list = (struct page_entry *) (num_frame_used * PGSIZE);
-    /* Update total pages used */
     num_frame_used += num_frame_for_page_ent;
+    struct page_entry **page_hash_buckets = (struct page_entry **) (num_frame_used * PGSIZE);
+    num_frame_used += num_frame_for_page_hash;
+    struct share *shares = (struct share *) (num_frame_used * PGSIZE);
+    struct list *share_buckets = (struct list *) (shares + NUM_SHARE);
+    num_frame_used += num_frame_for_share;
+    /* Set aside the first slabs of page entries and of free ranges. */
+    slab_pages = (void *) (num_frame_used * PGSIZE);
+    num_frame_used += SLAB_BOOT_PAGES;
+    vspace_pages = (void *) (num_frame_used * PGSIZE);
+    num_frame_used += SLAB_BOOT_PAGES;
+    /* Reserve pages of kernel address space for frame_window. */
+    window_page = num_frame_used;
+    num_frame_used += FRAME_WINDOW_PAGES;
 
-    /* Put global variables into frame */
+    /* Make the page directory. */
     pd = (uint32_t *) (num_frame_used * PGSIZE);
     memset(pd, 0, PGSIZE);
     num_frame_used++;
-    init_page_dir_sup = (struct list *) (num_frame_used * PGSIZE);
-    open_frame_list_user = (struct list *) (num_frame_used * PGSIZE + sizeof(struct list));
-    open_frame_list_kernel = (struct list *) (num_frame_used * PGSIZE + 2*sizeof(struct list));
-    open_page_entry = (struct list *) (num_frame_used * PGSIZE + 3*sizeof(struct list));
-    num_frame_used++;
+    /* Make the kernel page tables. */
+    for (i = 0; i < num_frame_for_kernel_pt; i++)
+    {
+        pt = (uint32_t *) (num_frame_used * PGSIZE);
+        memset(pt, 0, PGSIZE);
+        num_frame_used++;
+        pd[pd_no(PHYS_BASE) + i] = pde_create(pt);
+    }
+    /* Map all of physical memory at PHYS_MAP in 4 MB pages, which need no
+       page tables, so that any frame can be reached without mapping it. */
+    for (i = 0; i < DIV_ROUND_UP(init_ram_pages, LARGE_FRAMES); i++)
+    {
+        pd[pd_no(PHYS_MAP) + i] = pde_create_large(i * PTSPAN, false);
+    }
     /* Map and pin the first num_frame_used frames into init_page_dir */
-    pt = NULL;
     for (page = 0; page < num_frame_used; page++)
     {
         uintptr_t paddr = page * PGSIZE;
         char *vaddr = ptov(paddr);
-        size_t pde_idx = pd_no(vaddr);
         size_t pte_idx = pt_no(vaddr);
         bool in_kernel_text = &_start <= vaddr && vaddr < &_end_kernel_text;
 
-        if (pd[pde_idx] == 0)
-        {
-            pt = (uint32_t *) (num_frame_used * PGSIZE);
-            memset(pt, 0, PGSIZE);
-            num_frame_used++;
-            pd[pde_idx] = pde_create(pt);
-            pd[pde_idx] = pde_create(pt) | PTE_P | PTE_PIN;
-        }
-        
+        pt = (uint32_t *) (pd[pd_no(vaddr)] & PTE_ADDR);
         pt[pte_idx] = pte_create_kernel(paddr, !in_kernel_text) | PTE_P | PTE_PIN;
 
         /* Initialize frame entries */
-        frame_list_kernel[page].faddr = (void *) paddr;
-        frame_list_kernel[page].pte = &(pt[pte_idx]);
-        frame_list_kernel[page].sup_entry = NULL;
-        frame_list_kernel[page].owner = NULL;
+        frame_list_kernel[page].sup_entry = ptov((uintptr_t) &(page_entry_list[page]));
+        frame_list_kernel[page].shared = false;
+        frame_list_kernel[page].state = FRAME_USED;
 
         /* Initialize page_entry in page_entry_list */
         page_entry_list[page].vaddr = (uint8_t *) vaddr;
+        page_entry_list[page].owner = NULL;
         page_entry_list[page].source = FRAME_PAGE;
-        page_entry_list[page].data = &paddr;
+        page_entry_list[page].file = NULL;
+        page_entry_list[page].swap = NULL;
+        page_entry_list[page].f_page = 0;
+        page_entry_list[page].mmap = false;
+        page_entry_list[page].shared = false;
     }
     
     /* Convert address back into virtual address now that done writing to them */
     frame_list_kernel = ptov((uintptr_t) frame_list_kernel);
     frame_list_user = ptov((uintptr_t) frame_list_user);
     init_page_dir = ptov((uintptr_t) pd);
-    init_page_dir_sup = ptov((uintptr_t) init_page_dir_sup);
-    open_frame_list_user = ptov((uintptr_t) open_frame_list_user);
-    open_frame_list_kernel = ptov((uintptr_t) open_frame_list_kernel);
     page_entry_list = ptov((uintptr_t) page_entry_list);
-    open_page_entry = ptov((uintptr_t) open_page_entry);
+    page_hash_buckets = ptov((uintptr_t) page_hash_buckets);
+    vspace_pages = ptov((uintptr_t) vspace_pages);
+    shares = ptov((uintptr_t) shares);
+    share_buckets = ptov((uintptr_t) share_buckets);
+    slab_pages = ptov((uintptr_t) slab_pages);
+    boot_page_entry = page_entry_list;
     
+    /* Turn on CR4.PSE for the 4 MB pages of the physical memory map.
+       Kernel PTEs are global, so turn on CR4.PGE too, to keep them in the
+       TLB when CR3 is loaded on a process switch.  See [IA32-v3a] 3.7.3
+       "Mixing 4-KByte and 4-MByte Pages" and 3.11 "Translation Lookaside
+       Buffers". */
+    asm volatile ("movl %%cr4, %0; orl %1, %0; movl %0, %%cr4"
+                  : "=&r" (cr4) : "i" (CR4_PSE | CR4_PGE));
+
     /* Switch into the page directory that we created before we can initialize
        any lists, otherwise addresses will be physical and not virtal
        Store the physical address of the page directory into CR3 aka PDBR (page
@@ -162,22 +402,36 @@ void falloc_init(size_t user_frame_limit)
        [IA32-v3a] 3.7.5 "Base Address of the Page Directory". */
     asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)));
 
-    /* Initialize lists */
-    list_init(open_frame_list_user);
-    list_init(open_frame_list_kernel);
-    list_init(init_page_dir_sup);
-    list_init(open_page_entry);
-    
-    for (page = 0; page < num_frame_used; page++)
-    {
-        /* Will already be sorted by physical address */
-        list_push_back(init_page_dir_sup, &(page_entry_list[page].elem));
-    }
-    /* Add leftover page entries to open list */
-    for (page = num_frame_used; page < NUM_PAGE_ENTRY; page++)
+    /* Unmap the window pages.  Their page tables are shared by every page
+       directory, so the window can be used whichever is active. */
+    frame_window = ptov(window_page * PGSIZE);
+    for (i = 0; i < FRAME_WINDOW_PAGES; i++)
     {
-        list_push_back(open_page_entry, &(page_entry_list[page].elem));
+        uint8_t *vaddr = frame_window + i * PGSIZE;
+        frame_window_pte[i] = pde_get_pt(init_page_dir[pd_no(vaddr)]) +
+                              pt_no(vaddr);
     }
+    frame_window_cnt = FRAME_WINDOW_PAGES;
+    frame_unmap();
+    lock_init(&frame_lock);
+    cond_init(&frame_io_cond);
+    lock_init(&window_lock);
+    lock_init(&share_lock);
+    cond_init(&pageout_cond);
+    cond_init(&zero_cond);
+
+    /* Initialize lists */
+    free_list_init(&open_frame_list_user);
+    free_list_init(&open_frame_list_kernel);
+    free_list_init(&zeroed_frame_list_user);
+    free_list_init(&zeroed_frame_list_kernel);
+    
+    ASSERT(num_frame_used <= boot_page_entry_cnt);
+    /* Further page entries come from slabs. */
+    slab_init();
+    slab_cache_init(&page_entry_cache, "page_entry", sizeof(struct page_entry),
+                    slab_pages, SLAB_BOOT_PAGES);
+    share_init(shares, NUM_SHARE, share_buckets);
     /* Build open frame table entries, don't care about entry value */
     if (num_frame_used > kernel_frames)
     {
@@ -186,59 +440,276 @@ void falloc_init(size_t user_frame_limit)
     /* Add unused kernel frames to the kernel open list. */
     for (i = num_frame_used; i < kernel_frames; i++)
     {
-        frame_list_kernel[i].faddr = (void *) (i * PGSIZE);
-        list_push_back(open_frame_list_kernel, &(frame_list_kernel[i].open_elem));
+        frame_list_kernel[i].sup_entry = NULL;
+        frame_list_kernel[i].shared = false;
+        frame_list_kernel[i].state = FRAME_OPEN;
+        free_list_push_back(&open_frame_list_kernel, &(frame_list_kernel[i]));
     }
     /* Add unused user frames to the user open list. */
     for (i = 0; i < user_frames; i++)
     {
-        frame_list_user[i].faddr = (void *) (i * PGSIZE);
-        list_push_back(open_frame_list_user, &(frame_list_user[i].open_elem));
+        frame_list_user[i].sup_entry = NULL;
+        frame_list_user[i].shared = false;
+        frame_list_user[i].state = FRAME_OPEN;
+        free_list_push_back(&open_frame_list_user, &(frame_list_user[i]));
+    }
+    user_free_cnt = user_frames;
+
+    /* By default keep a thirty-second to a sixteenth of user frames free,
+       and never aim for more than half. */
+    if (!watermarks_set)
+    {
+        falloc_low_water = user_frames / 32 + 1;
+        falloc_high_water = 2 * falloc_low_water;
+    }
+    if (falloc_high_water > user_frames / 2)
+    {
+        falloc_high_water = user_frames / 2;
     }
+    if (falloc_low_water > falloc_high_water)
+    {
+        falloc_low_water = falloc_high_water;
+    }
+
+    /* Enter the pages mapped above into the supplemental page table, and
+       take them out of the free kernel address space. */
+    vspace_init(vspace_pages, SLAB_BOOT_PAGES);
+    palloc_init(page_hash_buckets, page_hash_bucket_cnt, kernel_pages,
+                page_entry_list, num_frame_used);
 }
 
 /*! Returns a frame from the space specified by USER (true = user space, false =
     kernel space). */
 struct frame *get_frame_addr(bool user)
 {
-    struct list_elem *elem;
+    bool zeroed;
+
+    return frame_get(user, false, &zeroed);
+}
+
+/*! Returns a frame from the space specified by USER, a zeroed one if ZERO
+    is true and one is free.  Sets *ZEROED to whether the frame is zeroed. */
+static struct frame *frame_get(bool user, bool zero, bool *zeroed)
+{
+    bool fs = false;
     struct frame *frame_entry;
-    struct list *open_frame_list;
-    struct thread *t = thread_current();
+
+    lock_acquire(&frame_lock);
+
+    /* If attempting to allocate frame, and out of frames, try evicting.
+       The pageout thread should usually have kept some free.  Eviction
+       drops the lock while writing, so another thread may take the frame
+       it frees; then try again, or wait for pages being written out.  If
+       only pages of mapped files are left while another thread holds the
+       file system lock, wait for that lock, which ranks above this one. */
+    frame_entry = frame_take_free(user, zero, zeroed);
+    while (frame_entry == NULL)
+    {
+        if (frame_evict(user))
+        {
+            direct_reclaim_cnt++;
+        }
+        else if (user && frame_io_cnt > 0)
+        {
+            cond_wait(&frame_io_cond, &frame_lock);
+        }
+        else if (user && !filesys_access_held())
+        {
+            lock_release(&frame_lock);
+            fs = fs_acquire();
+            lock_acquire(&frame_lock);
+        }
+        else
+        {
+            PANIC("falloc_get: out of frames");
+        }
+        frame_entry = frame_take_free(user, zero, zeroed);
+    }
+    fs_release(fs);
     
-    /* Choose the correct frame list. */
+    /* Wake the pageout thread once free user frames run low. */
+    if (user && user_free_cnt < falloc_low_water) {
+        cond_signal(&pageout_cond, &frame_lock);
+    }
+
+    lock_release(&frame_lock);
+
+    return frame_entry;
+}
+
+/*! Takes a free frame from the space specified by USER, preferring a
+    zeroed one if ZERO is true and one not zeroed otherwise, and sets
+    *ZEROED to whether it is zeroed.  Returns NULL if no frame is free.
+    The frame holds no page, so it is not evicted until given one.  Must be
+    called with the frame lock held. */
+static struct frame *frame_take_free(bool user, bool zero, bool *zeroed)
+{
+    struct free_list *open = user ? &open_frame_list_user
+                                  : &open_frame_list_kernel;
+    struct free_list *zeroes = user ? &zeroed_frame_list_user
+                                    : &zeroed_frame_list_kernel;
+    struct free_list *from = zero ? zeroes : open;
+    struct frame *f;
+
+    if (free_list_empty(from))
+    {
+        from = from == open ? zeroes : open;
+        if (free_list_empty(from))
+        {
+            return NULL;
+        }
+    }
+    *zeroed = from == zeroes;
+    if (*zeroed)
+    {
+        if (user)
+        {
+            zeroed_user_cnt--;
+        }
+        else
+        {
+            zeroed_kernel_cnt--;
+        }
+    }
     if (user)
     {
-        open_frame_list = open_frame_list_user;
+        user_free_cnt--;
     }
-    else
+    f = free_list_pop_front(from);
+    f->state = FRAME_USED;
+    f->shared = false;
+    f->sup_entry = NULL;
+    return f;
+}
+
+/*! Takes a run of LARGE_FRAMES free user frames starting at a 4 MB
+    boundary and returns the first, or NULL if there is none.  Runs are
+    sought from the top of memory down, away from the frames handed out
+    first, and are only taken while plenty of frames would be left free.
+    The frames are marked FRAME_LARGE, so they are never evicted.  Must be
+    called with the frame lock held. */
+static struct frame *frame_take_large(void)
+{
+    size_t first = ROUND_UP(kernel_frames, LARGE_FRAMES);
+    size_t base, i;
+
+    if (user_free_cnt < LARGE_FRAMES + falloc_high_water)
+    {
+        return NULL;
+    }
+    for (base = ROUND_DOWN(kernel_frames + user_frames, LARGE_FRAMES);
+         base >= first + LARGE_FRAMES; base -= LARGE_FRAMES)
     {
-        open_frame_list = open_frame_list_kernel;
+        struct frame *f = frame_list_kernel + base - LARGE_FRAMES;
+
+        for (i = 0; i < LARGE_FRAMES && (f[i].state == FRAME_OPEN ||
+                                         f[i].state == FRAME_ZEROED); i++)
+        {
+            continue;
+        }
+        if (i < LARGE_FRAMES)
+        {
+            continue;
+        }
+        for (i = 0; i < LARGE_FRAMES; i++)
+        {
+            if (f[i].state == FRAME_ZEROED)
+            {
+                free_list_remove(&zeroed_frame_list_user, &f[i]);
+                zeroed_user_cnt--;
+            }
+            else
+            {
+                free_list_remove(&open_frame_list_user, &f[i]);
+            }
+            f[i].state = FRAME_LARGE;
+            f[i].shared = false;
+            f[i].sup_entry = NULL;
+        }
+        user_free_cnt -= LARGE_FRAMES;
+        return f;
     }
+    return NULL;
+}
 
-    /* If attempting to allocate frame, and out of frames, try evicting. */
-    if (list_empty(open_frame_list))
+/*! Puts frame F, freed from the space specified by USER, on its open
+    list, and wakes the zeroing thread.  Must be called with the frame
+    lock held. */
+static void frame_put_free(struct frame *f, bool user)
+{
+    f->state = FRAME_OPEN;
+    if (user)
     {
-        frame_evict(user);
+        free_list_push_back(&open_frame_list_user, f);
+        user_free_cnt++;
     }
-    
-    /* If still no empty frame, panic system */
-    if (list_empty(open_frame_list))
+    else
     {
-        PANIC("falloc_get: out of frames");
+        free_list_push_back(&open_frame_list_kernel, f);
     }
-    /* Otherwise, get an open frame. */
-    elem = list_pop_front(open_frame_list);
+    cond_signal(&zero_cond, &frame_lock);
+}
 
-    /* Remove frame from list of open frames. */
-    frame_entry = list_entry(elem, struct frame, open_elem);
-    
-    /* Add to process list of frames if in user space. */
-    if (user) {
-        list_push_back(&(t->frames), &(frame_entry->process_elem));
+/*! Makes L an empty list. */
+static void free_list_init(struct free_list *l)
+{
+    l->head = l->tail = FRAME_NONE;
+}
+
+/*! Returns true if L is empty. */
+static bool free_list_empty(const struct free_list *l)
+{
+    return l->head == FRAME_NONE;
+}
+
+/*! Appends free frame F to L. */
+static void free_list_push_back(struct free_list *l, struct frame *f)
+{
+    uint32_t n = f - frame_list_kernel;
+
+    f->next = FRAME_NONE;
+    f->prev = l->tail;
+    if (l->tail != FRAME_NONE)
+    {
+        frame_list_kernel[l->tail].next = n;
+    }
+    else
+    {
+        l->head = n;
     }
+    l->tail = n;
+}
 
-    return frame_entry;
+/*! Removes and returns the first frame of L, which must not be empty. */
+static struct frame *free_list_pop_front(struct free_list *l)
+{
+    struct frame *f;
+
+    ASSERT(!free_list_empty(l));
+    f = &frame_list_kernel[l->head];
+    free_list_remove(l, f);
+    return f;
+}
+
+/*! Removes frame F from L. */
+static void free_list_remove(struct free_list *l, struct frame *f)
+{
+    if (f->prev != FRAME_NONE)
+    {
+        frame_list_kernel[f->prev].next = f->next;
+    }
+    else
+    {
+        l->head = f->next;
+    }
+    if (f->next != FRAME_NONE)
+    {
+        frame_list_kernel[f->next].prev = f->prev;
+    }
+    else
+    {
+        l->tail = f->prev;
+    }
 }
 
 /*! Obtains a single free frame and returns its kernel virtual
@@ -249,114 +720,1403 @@ void *falloc_get_frame(void *upage, bool user, struct page_entry *sup_entry)
     void *frame;
     struct thread *t = thread_current();
     uint32_t *pagedir = t->pagedir;                     /* Get page directory */
-    uint32_t *pte;
     struct frame *frame_entry;
     uint32_t bytes_read;
+    bool zeroed, present, fs;
 
-    /* Get the frame entry. */
-    frame_entry = get_frame_addr(user);
-    frame = frame_entry->faddr;
+    /* A page faulted on while it is written out is waited for.  Once
+       written, it is either gone from its frame or still in it. */
+    lock_acquire(&frame_lock);
+    while (sup_entry->source == FRAME_PAGE &&
+           page_frame(sup_entry)->state == FRAME_IO)
+    {
+        cond_wait(&frame_io_cond, &frame_lock);
+    }
+    present = sup_entry->source == FRAME_PAGE;
+    frame = present ? falloc_frame_addr(page_frame(sup_entry)) : NULL;
+    lock_release(&frame_lock);
+    if (present)
+    {
+        return frame;
+    }
 
-    /* NOTE: need to force read/write bit to always be valid. */
-    pte = lookup_page(init_page_dir, upage, false);
-    if (pte != NULL) {
-        ASSERT(pte_is_pinned(*pte));
-        ASSERT(!user);
-        pagedir = init_page_dir;
+    /* Shared pages are read once for all processes sharing them. */
+    if (sup_entry->shared)
+    {
+        return frame_share_in(sup_entry);
     }
 
-    ASSERT(pagedir != NULL);
-    ASSERT(!(*pte & PTE_P));
-    if (user) {
-        pagedir_set_page(pagedir, upage, frame, pte_is_read_write(*pte));
+    /* File and zero pages of a process bring in the pages after them. */
+    if (user && (sup_entry->source == FILE_PAGE ||
+                 sup_entry->source == ZERO_PAGE))
+    {
+        return frame_fault_around(upage, sup_entry,
+                                  frame_around_window(upage));
     }
-    else {
-        pagedir_set_page_kernel(pagedir, upage, frame, pte_is_read_write(*pte));
+
+    /* Get the frame entry, a zeroed one for a zero page if there is one. */
+    frame_entry = frame_get(user, sup_entry->source == ZERO_PAGE, &zeroed);
+    frame = falloc_frame_addr(frame_entry);
+
+    /* Kernel pages are mapped in init_page_dir, user pages in the
+       process's own page directory. */
+    if (!is_user_vaddr(upage))
+    {
+        pagedir = init_page_dir;
     }
-    pte = lookup_page(pagedir, upage, false);
-    *pte |= PTE_P;
 
-    /* Associate frame with page. */
-    frame_entry->pte = pte;
-    frame_entry->sup_entry = sup_entry;
-    frame_entry->owner = t;
-    
+    ASSERT(pagedir != NULL);
+    frame_install(pagedir, upage, frame, user);
+
     /* Load requested data into page. */
     switch (sup_entry->source)
     {
-    case ZERO_PAGE:     /* Zero the page. */
-        memset(upage, 0, PGSIZE);
+    case ZERO_PAGE:     /* Zero the page, unless already zeroed. */
+        zero_fill_cnt++;
+        if (zeroed)
+        {
+            prezeroed_cnt++;
+        }
+        else
+        {
+            memset(upage, 0, PGSIZE);
+        }
         break;
     case FILE_PAGE:     /* Read file into page. */
-        bytes_read = (uint32_t) file_read(sup_entry->data, upage, (off_t) PGSIZE);
+        fs = fs_acquire();
+        bytes_read = (uint32_t) file_read_at(sup_entry->file, upage,
+                                             (off_t) PGSIZE,
+                                             (off_t) sup_entry->f_page * PGSIZE);
+        fs_release(fs);
         memset(upage + bytes_read, 0,  PGSIZE - bytes_read);
-    case SWAP_PAGE:     /* Read data in from swap. */
-        swap_read_page(sup_entry->data, upage);
-        swalloc_free_swap(sup_entry->data);
+        break;
+    case SWAP_PAGE:     /* Read data in from swap, with the pages after it. */
+        ASSERT(user);
+        frame_swap_in(frame_entry, sup_entry->swap);
         break;
     case FRAME_PAGE:    /* Cannot have page already in frame */
         ASSERT(false);
     }
+
+    /* The page is clean if it matches its file or is all zeros, so that
+       eviction can drop it.  Data from swap has no other copy left. */
+    pagedir_set_dirty(pagedir, upage, sup_entry->source == SWAP_PAGE);
     
-    sup_entry->source = FRAME_PAGE;
-    sup_entry->data = frame;
+    frame_associate(frame_entry, sup_entry);
     
     return frame;
 }
 
-/*! Frees the frame at FRAME. */
-void falloc_free_frame(void *frame)
+/*! Brings the user file or zero page PAGE of the current process, at
+    UPAGE, into a frame along with up to CNT - 1 pages after it, as far as
+    they are loaded the same way and frames are free, and returns the
+    frame's address. */
+void *falloc_get_frames(void *upage, struct page_entry *page, size_t cnt)
 {
-    struct frame *frame_entry = addr_to_frame(frame);
-    uint32_t *pd = thread_current()->pagedir;       /* Get page directory */
-    uint32_t pte = *(frame_entry->pte);
-    void *upage = frame_entry->sup_entry->vaddr;    /* Get virtual addr */
-    struct list *open_frame_list;
-    bool user_space;
-    
-#ifndef NDEBUG
-    memset(frame, 0xcc, PGSIZE);
-#endif
+    ASSERT(page->source == FILE_PAGE || page->source == ZERO_PAGE);
+    ASSERT(!page->shared);
+    ASSERT(cnt > 0);
 
-    /* If it wasn't allocated, just return. */
-    if (!pte_is_present(pte))
+    return frame_fault_around(upage, page, cnt - 1 < FAULT_AROUND_MAX ?
+                                           cnt - 1 : FAULT_AROUND_MAX);
+}
+
+/*! Returns how many pages to bring in after a fault at UPAGE.  The window
+    doubles, up to FAULT_AROUND_MAX, each time a fault lands just past the
+    previous one, and halves when faults are not sequential. */
+static size_t frame_around_window(void *upage)
+{
+    struct thread *t = thread_current();
+
+    if ((uint8_t *) upage == t->fault_around_next)
     {
-        return;
+        t->fault_around = t->fault_around == 0 ? 1 : 2 * t->fault_around;
+        if (t->fault_around > FAULT_AROUND_MAX)
+        {
+            t->fault_around = FAULT_AROUND_MAX;
+        }
+    }
+    else
+    {
+        t->fault_around /= 2;
     }
+    return t->fault_around;
+}
+
+/*! Brings the file or zero page PAGE of the current process, at UPAGE,
+    into a frame and returns the frame's address.  Up to AROUND pages
+    after it that are loaded the same way, the rest of its segment, are
+    brought in too while free frames are above the low watermark.  A run
+    of file pages is read with a single read. */
+static void *frame_fault_around(void *upage, struct page_entry *page,
+                                size_t around)
+{
+    struct thread *t = thread_current();
+    struct frame *run[FAULT_AROUND_MAX + 1];
+    struct page_entry *pages[FAULT_AROUND_MAX + 1];
+    bool zeroed[FAULT_AROUND_MAX + 1];
+    bool zero = page->source == ZERO_PAGE;
+    off_t bytes_read = 0;
+    size_t cnt, i;
+    bool fs;
+
+    ASSERT(around <= FAULT_AROUND_MAX);
+
+    pages[0] = page;
+    run[0] = frame_get(true, zero, &zeroed[0]);
+    lock_acquire(&frame_lock);
+    for (cnt = 1; cnt <= around; cnt++)
+    {
+        pages[cnt] = frame_around_page(page, cnt);
+        if (pages[cnt] == NULL || user_free_cnt <= falloc_low_water)
+        {
+            break;
+        }
+        run[cnt] = frame_take_free(true, zero, &zeroed[cnt]);
+    }
+    lock_release(&frame_lock);
+    t->fault_around_next = (uint8_t *) upage + cnt * PGSIZE;
 
-    /* Need to figure out if in kernel or user list. */
-    if (is_user_vaddr(upage))
+    /* The frames hold no page until associated, so they are not evicted
+       while they are filled. */
+    for (i = 0; i < cnt; i++)
+    {
+        frame_install(t->pagedir, pages[i]->vaddr, falloc_frame_addr(run[i]), true);
+    }
+    if (page->source == FILE_PAGE)
     {
-        open_frame_list = open_frame_list_user;
-        user_space = true;
+        fs = fs_acquire();
+        bytes_read = file_read_at(page->file, upage, (off_t) (cnt * PGSIZE),
+                                  (off_t) page->f_page * PGSIZE);
+        fs_release(fs);
+        memset((uint8_t *) upage + bytes_read, 0, cnt * PGSIZE - bytes_read);
     }
     else
     {
-        open_frame_list = open_frame_list_kernel;
-        user_space = false;
+        for (i = 0; i < cnt; i++)
+        {
+            zero_fill_cnt++;
+            if (zeroed[i])
+            {
+                prezeroed_cnt++;
+            }
+            else
+            {
+                memset(pages[i]->vaddr, 0, PGSIZE);
+            }
+        }
     }
 
-    /* Remove page from page directory. */
-    pagedir_clear_page(pd, upage);
-    
-    /* Add frame struct back to open list. */
-    list_push_back(open_frame_list, &(frame_entry->open_elem));
-    
-    /* Remove from process list if in user space. */
-    if (user_space) {
-        list_remove(&(frame_entry->process_elem));
+    /* The pages match their file or are zeros, so they are clean.  Pages
+       mapped ahead are not yet accessed, so they go first if unused.  The
+       pages were just written through their user addresses, leaving TLB
+       entries marked dirty, so the bits are cleared by functions that
+       invalidate them; otherwise later writes would not mark the pages
+       dirty again. */
+    lock_acquire(&frame_lock);
+    for (i = 0; i < cnt; i++)
+    {
+        pagedir_set_dirty(t->pagedir, pages[i]->vaddr, false);
+        if (i > 0)
+        {
+            pagedir_set_accessed(t->pagedir, pages[i]->vaddr, false);
+        }
+        frame_associate(run[i], pages[i]);
     }
-    
+    fault_around_cnt += cnt - 1;
+    lock_release(&frame_lock);
+
+    return falloc_frame_addr(run[0]);
 }
 
-/*! Returns a pointer to the frame struct for the passed address. */
-static struct frame *addr_to_frame(void *frame_addr) {
-    return &(frame_list_kernel[pg_no(frame_addr)]);
+/*! Returns the page I pages after PAGE in its owner's address space if
+    it can be brought in along with PAGE: it is the same kind of private
+    page, and for a file page the next page of the same file.  Otherwise
+    returns NULL. */
+static struct page_entry *frame_around_page(struct page_entry *page,
+                                            size_t i)
+{
+    uint8_t *vaddr = page->vaddr + i * PGSIZE;
+    struct page_entry *next;
+
+    if (vaddr < page->vaddr || !is_user_vaddr(vaddr))
+    {
+        return NULL;
+    }
+    next = palloc_page_lookup(page->owner, vaddr);
+    if (next == NULL || next->source != page->source ||
+        next->shared || next->mmap != page->mmap)
+    {
+        return NULL;
+    }
+    if (page->source == FILE_PAGE &&
+        (next->file != page->file || next->f_page != page->f_page + i))
+    {
+        return NULL;
+    }
+    return next;
+}
+
+/*! Maps FRAME at UPAGE in page directory PD, as a user page if USER is
+    true.  The not-present entry left by palloc or by eviction keeps the
+    page's read/write and pinned bits.  Returns the page table entry. */
+static uint32_t *frame_install(uint32_t *pd, void *upage, void *frame,
+                               bool user)
+{
+    uint32_t *pte = lookup_page(pd, upage, false);
+    bool writable, pinned;
+
+    ASSERT(pte != NULL);
+    ASSERT(!(*pte & PTE_P));
+    writable = pte_is_read_write(*pte);
+    pinned = pte_is_pinned(*pte);
+    if (user) {
+        pagedir_set_page(pd, upage, frame, writable);
+    }
+    else {
+        pagedir_set_page_kernel(pd, upage, frame, writable);
+    }
+    *pte |= PTE_P | (pinned ? PTE_PIN : 0);
+    return pte;
 }
 
-/* TODO: implement frame_clean and frame_evict */
-/*! Selects a frame for eviction */
-void frame_evict(bool user)
+/*! Associates frame F, already mapped at PAGE, with PAGE, making it a
+    candidate for eviction.  The page goes last, as eviction skips frames
+    without one. */
+static void frame_associate(struct frame *f, struct page_entry *page)
 {
-    return;
-}
\ No newline at end of file
+    page->source = FRAME_PAGE;
+    f->age = 0x80;
+    f->last_use = timer_ticks();
+    f->shared = false;
+    f->sup_entry = page;
+}
+
+/*! Reads the page in swap slot SWAP_ENTRY into user frame F.  Slots that
+    follow it and hold other pages of the current process, most likely
+    its neighbours evicted in the same cluster, are read in the same device
+    command into free frames and mapped, as long as more than the low
+    watermark of free frames is left.  The frames read into hold no page
+    yet, so they are left alone while the frame lock is dropped for the
+    read.  Frees the slots read. */
+static void frame_swap_in(struct frame *f, struct swap *swap_entry)
+{
+    struct thread *t = thread_current();
+    struct frame *run[SWAP_CLUSTER];
+    struct swap *s = swap_entry;
+    size_t run_cnt, i;
+    bool zeroed;
+
+    lock_acquire(&frame_lock);
+    run[0] = f;
+    for (run_cnt = 1; run_cnt < SWAP_CLUSTER; run_cnt++)
+    {
+        s = swalloc_next_swap(s);
+        if (s == NULL || s->owner != t || s->page == NULL ||
+            s->page->source != SWAP_PAGE || s->page->swap != s ||
+            user_free_cnt <= falloc_low_water)
+        {
+            break;
+        }
+        run[run_cnt] = frame_take_free(true, false, &zeroed);
+        if (run[run_cnt] == NULL)
+        {
+            break;
+        }
+    }
+    lock_release(&frame_lock);
+
+    lock_acquire(&window_lock);
+    swap_read_pages(swap_entry, run_cnt, frame_map_multiple(run, run_cnt));
+    frame_unmap();
+    lock_release(&window_lock);
+
+    lock_acquire(&frame_lock);
+
+    /* Map the pages read ahead.  Like any page read from swap they are
+       dirty, but not yet accessed, so they go first if left unused. */
+    for (i = 1; i < run_cnt; i++)
+    {
+        struct page_entry *page = swap_entry[i].page;
+        uint32_t *pte = frame_install(t->pagedir, page->vaddr,
+                                      falloc_frame_addr(run[i]), true);
+        *pte = (*pte | PTE_D) & ~PTE_A;
+        page->swap = NULL;
+        swalloc_free_swap(&swap_entry[i]);
+        frame_associate(run[i], page);
+    }
+    swap_ahead_cnt += run_cnt - 1;
+    lock_release(&frame_lock);
+
+    swap_entry->page->swap = NULL;
+    swalloc_free_swap(swap_entry);
+}
+
+/*! Frees the frame at FRAME. */
+void falloc_free_frame(void *frame)
+{
+    lock_acquire(&frame_lock);
+    frame_free(addr_to_frame(frame));
+    lock_release(&frame_lock);
+}
+
+/*! Frees the frame holding PAGE, a kernel page or a page of the current
+    process, if it is in one of its own.  Shared pages and 4 MB pages are
+    left to falloc_unshare_page() and falloc_free_large().  A dirty page of
+    a mapped file is first written back to the file. */
+void falloc_free_page(struct page_entry *page)
+{
+    struct frame *f;
+
+    lock_acquire(&frame_lock);
+    if (page->source == FRAME_PAGE && !page->shared)
+    {
+        f = page_frame(page);
+        if (!f->shared && f->sup_entry == page)
+        {
+            frame_free(f);
+        }
+    }
+    lock_release(&frame_lock);
+}
+
+/*! Frees FRAME_ENTRY, a kernel frame or a frame of the current process.
+    If its page is being written out, waits for that first, after which the
+    page may have left the frame, and then there is nothing to free.  Must
+    be called with the frame lock held. */
+static void frame_free(struct frame *frame_entry)
+{
+    struct page_entry *page = frame_entry->sup_entry;
+    uint32_t *pd;
+    uint32_t pte;
+    void *upage;
+    bool user_space;
+
+    while (frame_entry->state == FRAME_IO)
+    {
+        cond_wait(&frame_io_cond, &frame_lock);
+    }
+    if (frame_entry->state != FRAME_USED || frame_entry->sup_entry != page)
+    {
+        return;
+    }
+
+    pte = *frame_pte(frame_entry);
+    upage = frame_entry->sup_entry->vaddr;          /* Get virtual addr */
+    user_space = is_user_vaddr(upage);
+    pd = user_space ? thread_current()->pagedir : init_page_dir;
+
+    /* If it wasn't allocated, just return. */
+    if (!pte_is_present(pte))
+    {
+        return;
+    }
+
+    /* Write a dirty page of a mapped file back before forgetting it. */
+    if (frame_entry->sup_entry->mmap && pagedir_is_dirty(pd, upage))
+    {
+        frame_writeback(frame_entry);
+    }
+    
+#ifndef NDEBUG
+    memset(frame_map(frame_entry), 0xcc, PGSIZE);
+#endif
+
+    /* Remove page from page directory. */
+    pagedir_clear_page(pd, upage);
+    
+    /* Add frame struct back to open list. */
+    frame_entry->sup_entry = NULL;
+    frame_put_free(frame_entry, user_space);
+}
+
+/*! Writes the page in user frame F, a dirty page of a mapped file, back
+    to the file and marks it clean.  Only the part of the page inside the
+    file is written.  The frame lock, which the caller must hold, is dropped
+    for the write, with F marked FRAME_IO so that it still holds the page
+    afterwards.  The file system lock is taken for the write unless the
+    current thread holds it. */
+static void frame_writeback(struct frame *f)
+{
+    struct page_entry *page = f->sup_entry;
+    off_t ofs = (off_t) page->f_page * PGSIZE;
+    off_t bytes;
+    bool fs;
+
+    /* Clear the dirty bit before copying, so that a write by the owner
+       during the transfer leaves the page dirty. */
+    pagedir_set_dirty(page->owner->pagedir, page->vaddr, false);
+    frame_io_begin(f);
+    lock_release(&frame_lock);
+
+    fs = fs_acquire();
+    bytes = file_length(page->file) - ofs;
+    if (bytes > PGSIZE)
+    {
+        bytes = PGSIZE;
+    }
+    if (bytes > 0)
+    {
+        file_write_at(page->file, frame_map(f), bytes, ofs);
+    }
+    fs_release(fs);
+
+    lock_acquire(&frame_lock);
+    frame_io_end(f);
+}
+
+/*! Marks user frame F, in use, as holding a page in transfer, so that it
+    is neither evicted nor freed while the frame lock is dropped.  Must be
+    called with the frame lock held. */
+static void frame_io_begin(struct frame *f)
+{
+    ASSERT(f->state == FRAME_USED);
+    f->state = FRAME_IO;
+    frame_io_cnt++;
+}
+
+/*! Ends the transfer begun by frame_io_begin() on F and wakes the threads
+    waiting for it.  Must be called with the frame lock held. */
+static void frame_io_end(struct frame *f)
+{
+    ASSERT(f->state == FRAME_IO);
+    f->state = FRAME_USED;
+    frame_io_cnt--;
+    cond_broadcast(&frame_io_cond, &frame_lock);
+}
+
+/*! Acquires the file system lock for a page transfer, unless the current
+    thread already holds it, having faulted in a system call that uses the
+    file system.  Returns whether it was acquired, for fs_release(). */
+static bool fs_acquire(void)
+{
+    if (filesys_access_held())
+    {
+        return false;
+    }
+    acquire_filesys_access();
+    return true;
+}
+
+/*! Releases the file system lock if fs_acquire() returned ACQUIRED. */
+static void fs_release(bool acquired)
+{
+    if (acquired)
+    {
+        release_filesys_access();
+    }
+}
+
+/*! Shares PAGE, a read-only file page of the current process, with the
+    other processes mapping the same page of the same file.  If one of them
+    has it in a frame, it is mapped at once.  If no entries are left for
+    sharing, PAGE stays private. */
+void falloc_share_page(struct page_entry *page)
+{
+    struct sharer *sh = share_sharer_alloc();
+    struct share *s;
+
+    if (sh == NULL)
+    {
+        return;
+    }
+    lock_acquire(&frame_lock);
+    s = share_get(file_get_inode(page->file), (off_t) page->f_page * PGSIZE);
+    if (s != NULL)
+    {
+        share_add(s, sh, page);
+        sh = NULL;
+        page->share = s;
+        page->shared = true;
+        if (s->frame != NULL)
+        {
+            frame_share_map(s->frame, page);
+            share_map_cnt++;
+        }
+    }
+    lock_release(&frame_lock);
+    share_sharer_free(sh);
+}
+
+/*! Stops sharing PAGE, unmapping it.  The frame holding the page is freed
+    once no process shares it. */
+void falloc_unshare_page(struct page_entry *page)
+{
+    struct share *s = page->share;
+    struct sharer *sh;
+
+    lock_acquire(&frame_lock);
+    if (page->source == FRAME_PAGE)
+    {
+        pagedir_clear_page(page->owner->pagedir, page->vaddr);
+        page->source = FILE_PAGE;
+    }
+    sh = share_remove(s, page);
+    page->shared = false;
+    page->swap = NULL;
+    if (s->ref_cnt == 1 && s->frame != NULL)
+    {
+        frame_share_release(s->frame);
+    }
+    share_put(s);
+    lock_release(&frame_lock);
+    share_sharer_free(sh);
+}
+
+/*! Backs the 4 MB of user virtual memory at UPAGE, which must be free and
+    4 MB aligned, with a zeroed 4 MB page of the current process: a run of
+    free user frames starting at a 4 MB boundary, mapped by one PDE.  A 4 MB
+    page is never evicted.  Returns false, allocating nothing, if there is
+    no such run or the process already has a page table there. */
+bool falloc_get_large(void *upage)
+{
+    struct thread *t = thread_current();
+    struct frame *f;
+    uintptr_t paddr;
+    size_t i;
+
+    ASSERT(((uintptr_t) upage & (PTSPAN - 1)) == 0);
+
+    if (lookup_page(t->pagedir, upage, false) != NULL)
+    {
+        return false;
+    }
+
+    lock_acquire(&frame_lock);
+    f = frame_take_large();
+    if (f == NULL)
+    {
+        large_fail_cnt++;
+    }
+    lock_release(&frame_lock);
+    if (f == NULL)
+    {
+        return false;
+    }
+    paddr = (uintptr_t) falloc_frame_addr(f);
+
+    if (palloc_make_multiple_addr(upage, PAL_USER | PAL_LARGE, LARGE_FRAMES,
+                                  ZERO_PAGE, NULL, NULL) == NULL)
+    {
+        lock_acquire(&frame_lock);
+        for (i = 0; i < LARGE_FRAMES; i++)
+        {
+            frame_put_free(&f[i], true);
+        }
+        lock_release(&frame_lock);
+        return false;
+    }
+
+    memset(pmap(paddr), 0, PTSPAN);
+    for (i = 0; i < LARGE_FRAMES; i++)
+    {
+        struct page_entry *page;
+
+        page = palloc_page_lookup(t, (uint8_t *) upage + i * PGSIZE);
+        ASSERT(page != NULL);
+        /* The frames stay FRAME_LARGE, so they are never chosen for
+           eviction. */
+        page->source = FRAME_PAGE;
+        f[i].sup_entry = page;
+    }
+    if (!pagedir_set_large(t->pagedir, upage, paddr))
+    {
+        NOT_REACHED();
+    }
+    large_cnt++;
+    return true;
+}
+
+/*! Unmaps the 4 MB page at UPAGE of the current process, made by
+    falloc_get_large(), and frees its frames.  Its page entries are left
+    for palloc_free_multiple(). */
+void falloc_free_large(void *upage)
+{
+    struct thread *t = thread_current();
+    struct frame *f;
+    size_t i;
+
+    f = addr_to_frame((void *) pde_get_large(t->pagedir[pd_no(upage)]));
+    pagedir_clear_large(t->pagedir, upage);
+
+    lock_acquire(&frame_lock);
+    for (i = 0; i < LARGE_FRAMES; i++)
+    {
+        f[i].sup_entry = NULL;
+        frame_put_free(&f[i], true);
+    }
+    lock_release(&frame_lock);
+}
+
+/*! Brings the shared page PAGE of the current process into a frame and
+    returns the frame's address.  The first process to fault reads the
+    page from its file, and the frame is then mapped into every process
+    sharing it, so that they need not fault. */
+static void *frame_share_in(struct page_entry *page)
+{
+    struct share *s = page->share;
+    struct thread *t = thread_current();
+    struct sharer *sh;
+    struct frame *f;
+    uint32_t bytes_read;
+    bool fs = false;
+
+    /* A thread that waited here while the page was read in finds it
+       already mapped.  The file system lock goes before the share lock, so
+       if the page is to be read, it is taken first and the check redone. */
+    lock_acquire(&share_lock);
+    if (s->frame == NULL && !filesys_access_held())
+    {
+        lock_release(&share_lock);
+        fs = fs_acquire();
+        lock_acquire(&share_lock);
+    }
+    lock_acquire(&frame_lock);
+    f = s->frame;
+    if (f != NULL && page->source != FRAME_PAGE)
+    {
+        frame_share_map(f, page);
+        share_map_cnt++;
+    }
+    lock_release(&frame_lock);
+
+    if (f == NULL)
+    {
+        /* The frame holds no page while it is read, so it is not evicted. */
+        f = get_frame_addr(true);
+        frame_install(t->pagedir, page->vaddr, falloc_frame_addr(f), true);
+        bytes_read = (uint32_t) file_read_at(page->file, page->vaddr,
+                                             (off_t) PGSIZE,
+                                             (off_t) page->f_page * PGSIZE);
+        ASSERT(filesys_access_held());
+        memset(page->vaddr + bytes_read, 0, PGSIZE - bytes_read);
+        pagedir_set_dirty(t->pagedir, page->vaddr, false);
+
+        lock_acquire(&frame_lock);
+        page->source = FRAME_PAGE;
+        for (sh = s->sharers; sh != NULL; sh = sh->next)
+        {
+            if (sh->page != page)
+            {
+                frame_share_map(f, sh->page);
+            }
+        }
+        f->age = 0x80;
+        f->last_use = timer_ticks();
+        f->shared = true;
+        f->share = s;
+        s->frame = f;
+        share_read_cnt++;
+        lock_release(&frame_lock);
+    }
+    lock_release(&share_lock);
+    fs_release(fs);
+    return falloc_frame_addr(f);
+}
+
+/*! Maps shared frame F at the not present shared page PAGE.  Must be
+    called with the frame lock held. */
+static void frame_share_map(struct frame *f, struct page_entry *page)
+{
+    frame_install(page->owner->pagedir, page->vaddr, falloc_frame_addr(f), true);
+    page->source = FRAME_PAGE;
+}
+
+/*! Puts user frame F, holding a shared page no longer mapped anywhere,
+    back on the open list.  Must be called with the frame lock held. */
+static void frame_share_release(struct frame *f)
+{
+    f->share->frame = NULL;
+    f->shared = false;
+    f->sup_entry = NULL;
+    frame_put_free(f, true);
+}
+
+/*! Returns a pointer to the frame struct for the passed address. */
+static struct frame *addr_to_frame(void *frame_addr) {
+    return &(frame_list_kernel[pg_no(frame_addr)]);
+}
+
+/*! Returns the frame holding PAGE, whose source must be FRAME_PAGE.  The
+    frame's address is in the page's page table entry, or in its PDE for a
+    4 MB page, which keeps it while the page is unmapped for eviction. */
+static struct frame *page_frame(struct page_entry *page)
+{
+    uint32_t *pd = page->owner != NULL ? page->owner->pagedir : init_page_dir;
+    uint32_t *pte = lookup_page(pd, page->vaddr, false);
+
+    ASSERT(page->source == FRAME_PAGE);
+    ASSERT(pte != NULL);
+    if (*pte & PTE_PS)
+    {
+        return addr_to_frame((void *) pde_get_large(*pte)) +
+               pt_no(page->vaddr);
+    }
+    return addr_to_frame(pte_get_page(*pte));
+}
+
+/*! Returns the page table entry mapping the page in frame F, which must
+    hold a page of its own. */
+static uint32_t *frame_pte(struct frame *f)
+{
+    struct page_entry *page = f->sup_entry;
+    uint32_t *pd = page->owner != NULL ? page->owner->pagedir : init_page_dir;
+
+    ASSERT(!f->shared && page != NULL);
+    return lookup_page(pd, page->vaddr, false);
+}
+
+/*! Returns the physical address of frame F, which is implied by its place
+    in the frame table: the user frames follow the kernel frames both in
+    the table and in physical memory. */
+void *falloc_frame_addr(const struct frame *f)
+{
+    return (void *) ((uintptr_t) (f - frame_list_kernel) * PGSIZE);
+}
+
+/*! Returns the virtual address of the page held in FRAME, given by its
+    physical address. */
+void *falloc_frame_vaddr(void *frame)
+{
+    struct frame *f = addr_to_frame(frame);
+
+    ASSERT(!f->shared && f->sup_entry != NULL);
+    return f->sup_entry->vaddr;
+}
+
+/*! Returns a kernel virtual address at which frame F can be reached.  A
+    single frame needs no mapping, as it is in the map of physical memory. */
+static void *frame_map(struct frame *f)
+{
+    return pmap((uintptr_t) falloc_frame_addr(f));
+}
+
+/*! Maps the CNT frames in FRAMES one after another at frame_window and
+    returns the kernel virtual address of the first. */
+static void *frame_map_multiple(struct frame **frames, size_t cnt)
+{
+    size_t i;
+
+    ASSERT(cnt <= FRAME_WINDOW_PAGES);
+    ASSERT(lock_held_by_current_thread(&window_lock));
+
+    for (i = 0; i < cnt; i++)
+    {
+        uint8_t *vaddr = frame_window + i * PGSIZE;
+        *frame_window_pte[i] = pte_create_kernel(falloc_frame_addr(frames[i]), true) |
+                               PTE_P | PTE_PIN;
+        tlb_invalidate_page(vaddr);
+    }
+    frame_window_cnt = cnt;
+    return frame_window;
+}
+
+/*! Unmaps whatever frames are mapped at frame_window. */
+static void frame_unmap(void)
+{
+    size_t i;
+
+    for (i = 0; i < frame_window_cnt; i++)
+    {
+        uint8_t *vaddr = frame_window + i * PGSIZE;
+        *frame_window_pte[i] = PTE_PIN;
+        tlb_invalidate_page(vaddr);
+    }
+    frame_window_cnt = 0;
+}
+
+/*! Selects the replacement policy named NAME, one of "clock", "aging" and
+    "wsclock". */
+void falloc_set_policy(const char *name)
+{
+    enum falloc_policy policy;
+
+    for (policy = FALLOC_CLOCK; name != NULL && policy <= FALLOC_WSCLOCK;
+         policy++)
+    {
+        if (!strcmp(name, policy_names[policy]))
+        {
+            falloc_policy = policy;
+            return;
+        }
+    }
+    PANIC("unknown eviction policy `%s'", name);
+}
+
+/*! Sets the free user frame watermarks from VALUE, "LOW,HIGH" or just
+    "LOW" for a high watermark of twice LOW.  A low watermark of 0 turns
+    the pageout thread off. */
+void falloc_set_watermarks(const char *value)
+{
+    const char *comma = value != NULL ? strchr(value, ',') : NULL;
+
+    if (value == NULL)
+    {
+        PANIC("-pageout needs a value");
+    }
+    falloc_low_water = atoi(value);
+    falloc_high_water = comma != NULL ? (uint32_t) atoi(comma + 1)
+                                      : 2 * falloc_low_water;
+    if (falloc_high_water < falloc_low_water)
+    {
+        PANIC("high watermark %"PRIu32" is below low watermark %"PRIu32,
+              falloc_high_water, falloc_low_water);
+    }
+    watermarks_set = true;
+}
+
+/*! Starts the pageout thread, unless it is turned off or there is no swap
+    device to clean pages to. */
+void falloc_start_pageout(void)
+{
+    if (falloc_low_water == 0 || user_frames == 0 || !swalloc_has_swap())
+    {
+        return;
+    }
+    thread_create("pageout", PRI_DEFAULT, pageout, NULL);
+}
+
+/*! Starts the thread that zeroes free frames while the CPU is idle.  It
+    makes itself as nice as possible once running, since the multi-level
+    feedback queue and stride schedulers ignore the priority given here. */
+void falloc_start_zeroer(void)
+{
+    thread_create("zeroer", PRI_MIN, zeroer, NULL);
+}
+
+/*! Prints eviction statistics. */
+void falloc_print_stats(void)
+{
+    printf("Frames: %lld evictions by %s (%lld to swap in %lld writes, "
+           "%lld to files, %lld dropped), %lld pages read ahead from swap\n",
+           evict_cnt, policy_names[falloc_policy], evict_swap_cnt,
+           evict_write_cnt, evict_file_cnt, evict_drop_cnt - evict_file_cnt,
+           swap_ahead_cnt);
+    printf("Pageout: %lld direct reclaims, %lld background reclaims, "
+           "%lld pages cleaned\n",
+           direct_reclaim_cnt, pageout_reclaim_cnt, pageout_clean_cnt);
+    printf("Share: %lld shared pages read, %lld mapped without a read\n",
+           share_read_cnt, share_map_cnt);
+    printf("Fault-around: %lld faults avoided\n", fault_around_cnt);
+    printf("Zero: %lld of %lld zero-fills pre-zeroed, %lld frames zeroed "
+           "while idle\n", prezeroed_cnt, zero_fill_cnt, zeroed_cnt);
+    printf("Large: %lld 4 MB pages mapped, %lld requests without frames\n",
+           large_cnt, large_fail_cnt);
+    slab_print_stats();
+    pagedir_print_stats();
+}
+
+/*! Returns true if user frame F holds a page that may be evicted.  Shared
+    pages are never pinned. */
+static bool frame_evictable(struct frame *f)
+{
+    if (f->state != FRAME_USED)
+    {
+        return false;
+    }
+    if (f->shared)
+    {
+        return true;
+    }
+    return f->sup_entry != NULL && !pte_is_pinned(*frame_pte(f));
+}
+
+/*! Returns true if the page in frame F has been accessed since the last
+    call, and clears its accessed bit.  A shared page counts as accessed
+    if any process sharing it accessed it. */
+static bool frame_test_accessed(struct frame *f)
+{
+    uint32_t *pd;
+    void *upage;
+    struct sharer *sh;
+    bool accessed = false;
+
+    if (f->shared)
+    {
+        for (sh = f->share->sharers; sh != NULL; sh = sh->next)
+        {
+            struct page_entry *page = sh->page;
+            if (pagedir_is_accessed(page->owner->pagedir, page->vaddr))
+            {
+                pagedir_set_accessed(page->owner->pagedir, page->vaddr,
+                                     false);
+                accessed = true;
+            }
+        }
+        return accessed;
+    }
+
+    pd = f->sup_entry->owner->pagedir;
+    upage = f->sup_entry->vaddr;
+    if (!pagedir_is_accessed(pd, upage))
+    {
+        return false;
+    }
+    pagedir_set_accessed(pd, upage, false);
+    return true;
+}
+
+/*! Second-chance clock: the hand clears accessed bits as it passes and
+    stops at the first frame not accessed since the last pass. */
+static struct frame *evict_clock(void)
+{
+    uint32_t i;
+
+    /* After one full turn every accessed bit is clear. */
+    for (i = 0; i < 2 * user_frames; i++)
+    {
+        struct frame *f = &frame_list_user[clock_hand];
+        clock_hand = (clock_hand + 1) % user_frames;
+        if (frame_evictable(f) && !frame_test_accessed(f))
+        {
+            return f;
+        }
+    }
+    return NULL;
+}
+
+/*! Aging: each eviction shifts every frame's counter right, adding the
+    accessed bit at the top, and picks the frame with the least counter. */
+static struct frame *evict_aging(void)
+{
+    struct frame *victim = NULL;
+    uint32_t i;
+
+    for (i = 0; i < user_frames; i++)
+    {
+        struct frame *f = &frame_list_user[i];
+        if (!frame_evictable(f))
+        {
+            continue;
+        }
+        f->age = (f->age >> 1) | (frame_test_accessed(f) ? 0x80 : 0);
+        if (victim == NULL || f->age < victim->age)
+        {
+            victim = f;
+        }
+    }
+    return victim;
+}
+
+/*! WSClock: like the clock, but a frame is only taken once it has been
+    unused for WSCLOCK_TAU ticks, and clean frames are preferred so that
+    most evictions need no write.  If no clean frame is old enough, the
+    oldest dirty one is written out instead.  Ages are kept mod 2**16
+    ticks, so a frame unused for longer may look recently used until it is
+    next found accessed. */
+static struct frame *evict_wsclock(void)
+{
+    uint16_t now = timer_ticks();
+    struct frame *oldest_dirty = NULL;
+    uint32_t i;
+
+    for (i = 0; i < user_frames; i++)
+    {
+        struct frame *f = &frame_list_user[clock_hand];
+        clock_hand = (clock_hand + 1) % user_frames;
+        if (!frame_evictable(f))
+        {
+            continue;
+        }
+        if (frame_test_accessed(f))
+        {
+            f->last_use = now;
+        }
+        else if ((uint16_t) (now - f->last_use) > WSCLOCK_TAU)
+        {
+            if (f->shared || !pagedir_is_dirty(f->sup_entry->owner->pagedir,
+                                               f->sup_entry->vaddr))
+            {
+                return f;
+            }
+            if (oldest_dirty == NULL ||
+                (uint16_t) (now - f->last_use) >
+                (uint16_t) (now - oldest_dirty->last_use))
+            {
+                oldest_dirty = f;
+            }
+        }
+    }
+    return oldest_dirty != NULL ? oldest_dirty : evict_clock();
+}
+
+/*! Returns the user frame holding OWNER's page at VADDR if that page can
+    join a cluster being written to swap: it is in a frame that may be
+    evicted, dirty, not accessed since its bit was last cleared, and not
+    part of a mapped file.  Otherwise returns NULL. */
+static struct frame *frame_cluster_page(struct thread *owner, void *vaddr)
+{
+    struct page_entry *page;
+    struct frame *f;
+
+    if (!is_user_vaddr(vaddr))
+    {
+        return NULL;
+    }
+    page = palloc_page_lookup(owner, vaddr);
+    if (page == NULL || page->source != FRAME_PAGE || page->mmap)
+    {
+        return NULL;
+    }
+    f = page_frame(page);
+    if (!frame_evictable(f) || f->shared || f->sup_entry != page ||
+        !pagedir_is_dirty(owner->pagedir, vaddr) ||
+        pagedir_is_accessed(owner->pagedir, vaddr))
+    {
+        return NULL;
+    }
+    return f;
+}
+
+/*! Puts user frame F, whose page has been saved or dropped, back on the
+    open list. */
+static void frame_release(struct frame *f)
+{
+    f->sup_entry = NULL;
+    frame_put_free(f, true);
+}
+
+/*! Writes the dirty page in user frame VICTIM, already unmapped, to swap.
+    The dirty pages that follow it in its owner's address space go with it
+    into consecutive slots, up to SWAP_CLUSTER pages in one device command,
+    so that they can later be read back together.  The frame lock, which
+    the caller must hold, is dropped for the write, with the frames marked
+    FRAME_IO. */
+static void frame_evict_cluster(struct frame *victim)
+{
+    struct frame *run[SWAP_CLUSTER];
+    struct thread *owner = victim->sup_entry->owner;
+    uint8_t *vaddr = victim->sup_entry->vaddr;
+    struct swap *first;
+    size_t run_cnt, i;
+
+    run[0] = victim;
+    for (run_cnt = 1; run_cnt < SWAP_CLUSTER; run_cnt++)
+    {
+        run[run_cnt] = frame_cluster_page(owner, vaddr + run_cnt * PGSIZE);
+        if (run[run_cnt] == NULL)
+        {
+            break;
+        }
+    }
+
+    /* Copies left in swap by cleaning are out of date. */
+    for (i = 0; i < run_cnt; i++)
+    {
+        struct page_entry *page = run[i]->sup_entry;
+        if (page->swap != NULL)
+        {
+            swalloc_free_swap(page->swap);
+            page->swap = NULL;
+        }
+    }
+
+    /* Fewer consecutive slots may be free than pages were found. */
+    run_cnt = swalloc_get_swaps(owner, run_cnt, &first);
+    for (i = 1; i < run_cnt; i++)
+    {
+        pagedir_clear_page(owner->pagedir, run[i]->sup_entry->vaddr);
+    }
+    for (i = 0; i < run_cnt; i++)
+    {
+        frame_io_begin(run[i]);
+    }
+    lock_release(&frame_lock);
+
+    lock_acquire(&window_lock);
+    swap_write_pages(first, run_cnt, frame_map_multiple(run, run_cnt));
+    frame_unmap();
+    lock_release(&window_lock);
+
+    lock_acquire(&frame_lock);
+    for (i = 0; i < run_cnt; i++)
+    {
+        struct page_entry *page = run[i]->sup_entry;
+        page->source = SWAP_PAGE;
+        page->swap = &first[i];
+        first[i].page = page;
+        frame_io_end(run[i]);
+        frame_release(run[i]);
+    }
+    evict_cnt += run_cnt;
+    evict_swap_cnt += run_cnt;
+    evict_write_cnt++;
+}
+
+/*! Evicts the shared page in user frame F and puts F back on the open
+    list.  The page is unmapped from every process sharing it and dropped,
+    as it is read-only and can be read from its file again. */
+static void frame_evict_shared(struct frame *f)
+{
+    struct sharer *sh;
+
+    for (sh = f->share->sharers; sh != NULL; sh = sh->next)
+    {
+        pagedir_clear_page(sh->page->owner->pagedir, sh->page->vaddr);
+        sh->page->source = FILE_PAGE;
+    }
+    frame_share_release(f);
+    evict_drop_cnt++;
+    evict_cnt++;
+}
+
+/*! Evicts the page in user frame F and puts F back on the open list.  A
+    clean page is dropped, to be read back from its swap copy or file or
+    zeroed again.  A dirty page of a mapped file is written back to the
+    file and dropped; any other dirty page is written to swap, along with
+    the dirty pages after it.  Returns false, leaving F alone, if F holds a
+    page of a mapped file and the file system lock is busy. */
+static bool frame_evict_page(struct frame *f)
+{
+    struct page_entry *page = f->sup_entry;
+    bool fs = false;
+    uint32_t *pd;
+
+    if (f->shared)
+    {
+        frame_evict_shared(f);
+        return true;
+    }
+    pd = page->owner->pagedir;
+
+    /* A page of a mapped file may need writing back.  The file system lock
+       ranks above the frame lock, so it may only be tried here: its holder
+       may be faulting on this very page. */
+    if (page->mmap && !filesys_access_held())
+    {
+        if (!try_acquire_filesys_access())
+        {
+            return false;
+        }
+        fs = true;
+    }
+
+    /* Unmap the page first, so that its owner faults and waits for the
+       frame lock instead of changing the page while it is saved. */
+    pagedir_clear_page(pd, page->vaddr);
+
+    if (pagedir_is_dirty(pd, page->vaddr))
+    {
+        if (!page->mmap)
+        {
+            frame_evict_cluster(f);
+            return true;
+        }
+        frame_writeback(f);
+        evict_file_cnt++;
+    }
+    fs_release(fs);
+
+    if (page->swap != NULL)
+    {
+        page->source = SWAP_PAGE;
+    }
+    else
+    {
+        page->source = page->file != NULL ? FILE_PAGE : ZERO_PAGE;
+    }
+    evict_drop_cnt++;
+    evict_cnt++;
+    frame_release(f);
+    return true;
+}
+
+/*! Frees a frame in the space specified by USER by evicting a page chosen
+    by falloc_policy, returning true if one was freed.  Kernel frames hold
+    paging data and are never evicted.  Must be called with the frame lock
+    held. */
+bool frame_evict(bool user)
+{
+    struct frame *victim = NULL;
+    struct tlb_batch batch;
+
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+
+    if (!user || user_frames == 0)
+    {
+        return false;
+    }
+
+    /* The sweep clears accessed bits of many pages, some perhaps of the
+       running process, which then need one flush at the end. */
+    pagedir_batch_begin(&batch, thread_current()->pagedir);
+    switch (falloc_policy)
+    {
+    case FALLOC_CLOCK:
+        victim = evict_clock();
+        break;
+    case FALLOC_AGING:
+        victim = evict_aging();
+        break;
+    case FALLOC_WSCLOCK:
+        victim = evict_wsclock();
+        break;
+    }
+
+    if (victim != NULL && !frame_evict_page(victim))
+    {
+        victim = NULL;
+    }
+    pagedir_batch_end(&batch);
+    return victim != NULL;
+}
+
+/*! Writes the dirty page in user frame F to its file if it is part of a
+    mapped file, or else to swap, while leaving it mapped, so that evicting
+    it later needs no write.  A page written to swap keeps the slot as a
+    clean copy until it is evicted or freed; if it is dirtied again in the
+    meantime, the copy is rewritten by the next cleaning or dropped by
+    eviction.  A page needing a new slot is skipped once swap runs low. */
+static void frame_clean(struct frame *f)
+{
+    struct page_entry *page = f->sup_entry;
+
+    if (page->mmap)
+    {
+        /* As in eviction, skip the page if the file system is busy. */
+        if (filesys_access_held())
+        {
+            frame_writeback(f);
+        }
+        else if (try_acquire_filesys_access())
+        {
+            frame_writeback(f);
+            release_filesys_access();
+        }
+        else
+        {
+            return;
+        }
+        pageout_clean_cnt++;
+        return;
+    }
+
+    /* A slot held by a resident page is one fewer for eviction, so only
+       take one while more are free than could be needed to evict every
+       user frame, and otherwise leave the page to eviction. */
+    if (page->swap == NULL)
+    {
+        page->swap = swalloc_try_get_swap(page->owner, user_frames);
+        if (page->swap == NULL)
+        {
+            return;
+        }
+        page->swap->page = page;
+    }
+
+    /* Clear the dirty bit before copying, so that a write by the owner
+       during the transfer leaves the page dirty. */
+    pagedir_set_dirty(page->owner->pagedir, page->vaddr, false);
+    frame_io_begin(f);
+    lock_release(&frame_lock);
+    swap_write_page(page->swap, frame_map(f));
+    lock_acquire(&frame_lock);
+    frame_io_end(f);
+    pageout_clean_cnt++;
+}
+
+/*! Cleans up to PAGEOUT_CLEAN_MAX dirty user pages not accessed since
+    their bits were last cleared, so that their frames can be reclaimed
+    quickly when needed.  Must be called with the frame lock held, which
+    is dropped while each page is written. */
+static void frame_preclean(void)
+{
+    uint32_t i, cleaned = 0;
+
+    for (i = 0; i < user_frames && cleaned < PAGEOUT_CLEAN_MAX; i++)
+    {
+        struct frame *f = &frame_list_user[clean_hand];
+        clean_hand = (clean_hand + 1) % user_frames;
+        if (frame_evictable(f) && !f->shared &&
+            pagedir_is_dirty(f->sup_entry->owner->pagedir,
+                             f->sup_entry->vaddr) &&
+            !pagedir_is_accessed(f->sup_entry->owner->pagedir,
+                                 f->sup_entry->vaddr))
+        {
+            frame_clean(f);
+            cleaned++;
+        }
+    }
+}
+
+/*! Pageout thread.  Whenever free user frames drop below the low
+    watermark, evicts pages until the high watermark is reached, then
+    cleans some dirty pages, so that faults usually find a free frame or
+    a clean page to drop. */
+static void pageout(void *aux UNUSED)
+{
+    lock_acquire(&frame_lock);
+    for (;;)
+    {
+        cond_wait(&pageout_cond, &frame_lock);
+        while (user_free_cnt < falloc_high_water && frame_evict(true))
+        {
+            pageout_reclaim_cnt++;
+
+            /* Let faulting threads at the frame lock between evictions. */
+            lock_release(&frame_lock);
+            thread_yield();
+            lock_acquire(&frame_lock);
+        }
+        frame_preclean();
+    }
+}
+
+/*! Zeroing thread.  It runs at the lowest priority, nicest niceness and
+    fewest tickets, so only when the CPU would otherwise be idle, and moves
+    free frames to the zeroed lists, up to ZEROED_MAX in each pool, so that
+    zero-fill faults find them ready.  Each frame is zeroed with the frame
+    lock released, marked in use so that nothing else takes it meanwhile,
+    because a faulting thread waiting on the lock could not lend this
+    thread its priority under the multi-level feedback queue scheduler. */
+static void zeroer(void *aux UNUSED)
+{
+    thread_set_nice(NICE_MAX);
+    thread_set_tickets(TICKETS_MIN);
+
+    lock_acquire(&frame_lock);
+    for (;;)
+    {
+        struct frame *f;
+        bool user = zeroed_user_cnt < ZEROED_MAX &&
+                    !free_list_empty(&open_frame_list_user);
+
+        if (!user && (zeroed_kernel_cnt >= ZEROED_MAX ||
+                      free_list_empty(&open_frame_list_kernel)))
+        {
+            cond_wait(&zero_cond, &frame_lock);
+            continue;
+        }
+
+        f = free_list_pop_front(user ? &open_frame_list_user
+                                     : &open_frame_list_kernel);
+        f->state = FRAME_USED;
+        if (user)
+        {
+            user_free_cnt--;
+        }
+        lock_release(&frame_lock);
+
+        memset(frame_map(f), 0, PGSIZE);
+
+        lock_acquire(&frame_lock);
+        f->state = FRAME_ZEROED;
+        if (user)
+        {
+            free_list_push_back(&zeroed_frame_list_user, f);
+            zeroed_user_cnt++;
+            user_free_cnt++;
+        }
+        else
+        {
+            free_list_push_back(&zeroed_frame_list_kernel, f);
+            zeroed_kernel_cnt++;
+        }
+        zeroed_cnt++;
+
+        /* Let threads of the same priority run between frames. */
+        lock_release(&frame_lock);
+        thread_yield();
+        lock_acquire(&frame_lock);
+    }
+}
@@ -7,20 +7,61 @@
 #include "threads/synch.h"
 #include "threads/thread.h"
 
-/*! A frame entry struct. */
+/*! Where a frame is.  Free frames are on an open list, or on a zeroed list
+    once the zeroing thread has cleared them.  A frame whose page is being
+    written out is neither evicted nor freed until the transfer ends. */
+enum frame_state {
+    FRAME_USED,                     /*!< Holds a page, or is being given one. */
+    FRAME_IO,                       /*!< Holds a page being written out. */
+    FRAME_LARGE,                    /*!< Part of a 4 MB page, never evicted. */
+    FRAME_OPEN,                     /*!< Free. */
+    FRAME_ZEROED                    /*!< Free and zeroed. */
+};
+
+/*! A frame entry struct.  Entries are kept in one table indexed by frame
+    number, so the address of the frame is implied by the entry's place in
+    it; see falloc_frame_addr().  The page table entry and owner of a frame
+    in use follow from its page, and a free frame is linked into its list by
+    frame numbers, which keeps an entry to 16 bytes. */
 struct frame {
-    void *faddr;                    /*!< Address of corresponding frame. */
-    uint32_t *pte;                  /*!< Related page table entry. */
-    struct page_entry *sup_entry;   /*!< Supplemental page table entry. */
-    struct thread *owner;           /*!< Thread which owns the frame. */
-    struct list_elem process_elem;  /*!< List element for process. */
-    struct list_elem open_elem;     /*!< List element for open list. */
+    union {
+        struct page_entry *sup_entry;   /*!< Page held, or NULL. */
+        struct share *share;            /*!< Shared page held, if shared. */
+    };
+    uint32_t next;                  /*!< Next frame number on a free list. */
+    uint32_t prev;                  /*!< Previous frame number on a free list. */
+    uint16_t last_use;              /*!< Tick of last observed use, mod 2**16. */
+    uint8_t age;                    /*!< Aging counter, newest use on top. */
+    enum frame_state state : 7;     /*!< Free or in use. */
+    bool shared : 1;                /*!< Holds share rather than sup_entry. */
 };
 
+/*! Frame replacement policies, chosen with the -evict option. */
+enum falloc_policy {
+    FALLOC_CLOCK,                   /*!< Second-chance clock. */
+    FALLOC_AGING,                   /*!< Least aging counter. */
+    FALLOC_WSCLOCK                  /*!< Working-set clock. */
+};
+
+extern enum falloc_policy falloc_policy;
+
 void falloc_init(size_t user_page_limit);
+void falloc_set_policy(const char *name);
+void falloc_set_watermarks(const char *value);
+void falloc_start_pageout(void);
+void falloc_start_zeroer(void);
+void falloc_print_stats(void);
 struct frame *get_frame_addr(bool user);
+void *falloc_frame_addr(const struct frame *);
+void *falloc_frame_vaddr(void *frame);
 void *falloc_get_frame(void *upage, bool user, struct page_entry *sup_entry);
+void *falloc_get_frames(void *upage, struct page_entry *, size_t cnt);
 void falloc_free_frame(void *frame);
+void falloc_free_page(struct page_entry *);
+void falloc_share_page(struct page_entry *);
+void falloc_unshare_page(struct page_entry *);
+bool falloc_get_large(void *upage);
+void falloc_free_large(void *upage);
 
 struct page_entry *get_page_entry(void);
 void free_page_entry(struct page_entry *);
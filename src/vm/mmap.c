@@ -0,0 +1,245 @@
+#include "vm/mmap.h"
+#include <debug.h>
+#include <round.h>
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/falloc.h"
+
+static mapid_t allocate_mapid(void);
+static struct mmap *mmap_lookup(mapid_t);
+static void mmap_release(struct mmap *);
+
+/*! Maps FILE into the current process's address space starting at the
+    page ADDR, returning the mapping identifier, or MAP_FAILED if FILE is
+    NULL or empty, or the pages are not free user pages.  No data is read
+    here: each page faults in from the file on first use, and dirty pages
+    are written back when they are evicted or unmapped.  The mapping keeps
+    its own reopened file, so closing FILE does not affect it. */
+mapid_t mmap_map(struct file *file, void *addr)
+{
+    struct thread *t = thread_current();
+    struct mmap *m;
+    off_t length;
+    size_t page_cnt;
+
+    if (file == NULL || addr == NULL || pg_ofs(addr) != 0)
+    {
+        return MAP_FAILED;
+    }
+
+    acquire_filesys_access();
+    length = file_length(file);
+    release_filesys_access();
+    if (length == 0)
+    {
+        return MAP_FAILED;
+    }
+    page_cnt = DIV_ROUND_UP(length, PGSIZE);
+
+    /* The whole range must be free user pages. */
+    if (!is_user_vaddr(addr) ||
+        (uintptr_t) PHYS_BASE - (uintptr_t) addr < page_cnt * PGSIZE ||
+        !palloc_block_open(addr, page_cnt))
+    {
+        return MAP_FAILED;
+    }
+
+    m = malloc(sizeof(struct mmap));
+    if (m == NULL)
+    {
+        return MAP_FAILED;
+    }
+    acquire_filesys_access();
+    m->file = file_reopen(file);
+    release_filesys_access();
+    if (m->file == NULL)
+    {
+        free(m);
+        return MAP_FAILED;
+    }
+
+    if (palloc_make_multiple_addr(addr, PAL_USER | PAL_MMAP, page_cnt,
+                                  FILE_PAGE, m->file, 0) == NULL)
+    {
+        acquire_filesys_access();
+        file_close(m->file);
+        release_filesys_access();
+        free(m);
+        return MAP_FAILED;
+    }
+
+    m->id = allocate_mapid();
+    m->addr = addr;
+    m->page_cnt = page_cnt;
+    list_push_back(&(t->mmaps), &(m->elem));
+    return m->id;
+}
+
+/*! Maps SIZE bytes of zeroed memory, rounded up to whole pages, into the
+    current process's address space starting at the page ADDR, returning
+    the mapping identifier, or MAP_FAILED if SIZE is 0 or the pages are not
+    free user pages.  The pages are paged in and out like the process's own
+    data.  If FLAGS has MAP_LARGE, each 4 MB aligned stretch of the mapping
+    is instead backed by a 4 MB page, if a run of free frames allows, so
+    that walking a large array takes one TLB entry per 4 MB. */
+mapid_t mmap_map_anon(void *addr, size_t size, int flags)
+{
+    struct thread *t = thread_current();
+    struct mmap *m;
+    size_t page_cnt;
+    uint8_t *upage, *end;
+
+    if (addr == NULL || pg_ofs(addr) != 0 || size == 0 ||
+        size > (uintptr_t) PHYS_BASE)
+    {
+        return MAP_FAILED;
+    }
+    page_cnt = DIV_ROUND_UP(size, PGSIZE);
+
+    /* The whole range must be free user pages. */
+    if (!is_user_vaddr(addr) ||
+        (uintptr_t) PHYS_BASE - (uintptr_t) addr < page_cnt * PGSIZE ||
+        !palloc_block_open(addr, page_cnt))
+    {
+        return MAP_FAILED;
+    }
+
+    m = malloc(sizeof(struct mmap));
+    if (m == NULL)
+    {
+        return MAP_FAILED;
+    }
+    m->id = allocate_mapid();
+    m->file = NULL;
+    m->addr = addr;
+    m->page_cnt = 0;
+    list_push_back(&(t->mmaps), &(m->elem));
+
+    /* Map a 4 MB page at a time where asked and possible, and otherwise
+       ordinary pages up to the next 4 MB boundary. */
+    upage = addr;
+    end = upage + page_cnt * PGSIZE;
+    while (upage < end)
+    {
+        uint8_t *next;
+
+        if ((flags & MAP_LARGE) && ((uintptr_t) upage & (PTSPAN - 1)) == 0 &&
+            (size_t) (end - upage) >= PTSPAN && falloc_get_large(upage))
+        {
+            next = upage + PTSPAN;
+        }
+        else
+        {
+            next = (uint8_t *) ROUND_UP((uintptr_t) upage + 1, PTSPAN);
+            if (next > end)
+            {
+                next = end;
+            }
+            if (palloc_make_multiple_addr(upage, PAL_USER,
+                                          (next - upage) / PGSIZE,
+                                          ZERO_PAGE, NULL, NULL) == NULL)
+            {
+                mmap_release(m);
+                return MAP_FAILED;
+            }
+        }
+        m->page_cnt += (next - upage) / PGSIZE;
+        upage = next;
+    }
+    return m->id;
+}
+
+/*! Unmaps the mapping MAPPING of the current process, writing its dirty
+    pages back to the file.  Does nothing if there is no such mapping. */
+void mmap_unmap(mapid_t mapping)
+{
+    struct mmap *m = mmap_lookup(mapping);
+
+    if (m != NULL)
+    {
+        mmap_release(m);
+    }
+}
+
+/*! Unmaps all mappings of the current process, as it exits. */
+void mmap_unmap_all(void)
+{
+    struct thread *t = thread_current();
+
+    while (!list_empty(&(t->mmaps)))
+    {
+        mmap_release(list_entry(list_front(&(t->mmaps)), struct mmap, elem));
+    }
+}
+
+/*! Returns a new mapping identifier. */
+static mapid_t allocate_mapid(void)
+{
+    static mapid_t next_mapid = 0;
+    return next_mapid++;
+}
+
+/*! Returns the mapping MAPPING of the current process, or NULL. */
+static struct mmap *mmap_lookup(mapid_t mapping)
+{
+    struct thread *t = thread_current();
+    struct list_elem *e;
+
+    for (e = list_begin(&(t->mmaps)); e != list_end(&(t->mmaps));
+         e = list_next(e))
+    {
+        struct mmap *m = list_entry(e, struct mmap, elem);
+        if (m->id == mapping)
+        {
+            return m;
+        }
+    }
+    return NULL;
+}
+
+/*! Writes back and frees the pages of M, then closes its file, if any, and
+    frees M.  Only pages dirtied since they were read or last written back
+    are written. */
+static void mmap_release(struct mmap *m)
+{
+    struct thread *t = thread_current();
+    struct tlb_batch batch;
+    size_t i;
+
+    pagedir_batch_begin(&batch, t->pagedir);
+    for (i = 0; i < m->page_cnt; i++)
+    {
+        void *upage = (uint8_t *) m->addr + i * PGSIZE;
+        struct page_entry *page = palloc_page_lookup(t, upage);
+
+        ASSERT(page != NULL);
+        if (pagedir_is_large(t->pagedir, upage))
+        {
+            falloc_free_large(upage);
+            i += PTSPAN / PGSIZE - 1;
+        }
+        else
+        {
+            falloc_free_page(page);
+        }
+    }
+    if (m->page_cnt > 0)
+    {
+        palloc_free_multiple(m->addr, m->page_cnt);
+    }
+    pagedir_batch_end(&batch);
+
+    if (m->file != NULL)
+    {
+        acquire_filesys_access();
+        file_close(m->file);
+        release_filesys_access();
+    }
+    list_remove(&(m->elem));
+    free(m);
+}
@@ -0,0 +1,30 @@
+#ifndef VM_MMAP_H
+#define VM_MMAP_H
+
+#include <stddef.h>
+#include <list.h>
+#include "filesys/file.h"
+
+/*! Mapping identifier. */
+typedef int mapid_t;
+#define MAP_FAILED ((mapid_t) -1)       /*!< Returned when mapping fails. */
+
+/*! Flags for mmap_map_anon(). */
+#define MAP_LARGE 0x1                   /*!< Use 4 MB pages where possible. */
+
+/*! A file, or zeroed memory, mapped into the address space of a process. */
+struct mmap {
+    mapid_t id;                     /*!< Mapping identifier. */
+    struct file *file;              /*!< Reopened file backing the pages,
+                                         or NULL for zeroed memory. */
+    void *addr;                     /*!< First mapped page. */
+    size_t page_cnt;                /*!< Number of mapped pages. */
+    struct list_elem elem;          /*!< List element for process. */
+};
+
+mapid_t mmap_map(struct file *, void *addr);
+mapid_t mmap_map_anon(void *addr, size_t size, int flags);
+void mmap_unmap(mapid_t);
+void mmap_unmap_all(void);
+
+#endif /* vm/mmap.h */
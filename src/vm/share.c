@@ -0,0 +1,155 @@
+/*! \file share.c
+
+   Table of read-only executable pages shared between processes.  Entries
+   come from a fixed pool set aside by falloc_init(), so that they can be
+   used while handling page faults.  The table is protected by the frame
+   lock, which every caller holds.
+
+   Each sharing page entry is chained to its share by a sharer from a slab
+   cache.  Sharers are allocated and freed without the frame lock, as
+   growing or shrinking the cache maps or frees a kernel page. */
+
+#include "vm/share.h"
+#include <debug.h>
+#include "threads/vaddr.h"
+#include "vm/slab.h"
+
+/*! Shared pages, keyed by inode and offset. */
+static struct hash share_table;
+
+/*! Unused entries. */
+static struct list free_shares;
+
+/*! Cache of sharers. */
+static struct slab_cache sharer_cache;
+
+static unsigned share_hash(const struct hash_elem *, void *aux);
+static bool share_less(const struct hash_elem *, const struct hash_elem *,
+                       void *aux);
+
+/*! Initializes the table with the SHARE_CNT entries at POOL and the
+    SHARE_HASH_BUCKETS lists at BUCKETS.  The slab allocator must be
+    initialized. */
+void share_init(struct share *pool, size_t share_cnt, struct list *buckets)
+{
+    size_t i;
+
+    hash_init_fixed(&share_table, buckets, SHARE_HASH_BUCKETS, share_hash,
+                    share_less, NULL);
+    list_init(&free_shares);
+    for (i = 0; i < share_cnt; i++)
+    {
+        list_push_back(&free_shares, &(pool[i].free_elem));
+    }
+    slab_cache_init(&sharer_cache, "sharer", sizeof(struct sharer), NULL, 0);
+}
+
+/*! Returns the shared page at offset OFS of INODE, creating it if it does
+    not exist, and counts one more reference to it.  Returns NULL if the
+    page is not shared yet and no entries are left. */
+struct share *share_get(struct inode *inode, off_t ofs)
+{
+    struct share key, *s;
+    struct hash_elem *e;
+
+    key.inode = inode;
+    key.ofs = ofs;
+    e = hash_find(&share_table, &(key.hash_elem));
+    if (e != NULL)
+    {
+        s = hash_entry(e, struct share, hash_elem);
+    }
+    else
+    {
+        if (list_empty(&free_shares))
+        {
+            return NULL;
+        }
+        s = list_entry(list_pop_front(&free_shares), struct share, free_elem);
+        s->inode = inode;
+        s->ofs = ofs;
+        s->frame = NULL;
+        s->ref_cnt = 0;
+        s->sharers = NULL;
+        hash_insert(&share_table, &(s->hash_elem));
+    }
+    s->ref_cnt++;
+    return s;
+}
+
+/*! Drops a reference to S, freeing it when none are left.  Its frame must
+    have been released before the last reference is dropped. */
+void share_put(struct share *s)
+{
+    ASSERT(s->ref_cnt > 0);
+
+    if (--s->ref_cnt == 0)
+    {
+        ASSERT(s->frame == NULL);
+        ASSERT(s->sharers == NULL);
+        hash_delete(&share_table, &(s->hash_elem));
+        list_push_back(&free_shares, &(s->free_elem));
+    }
+}
+
+/*! Returns a new sharer, or a null pointer if none can be allocated.  The
+    frame lock must not be held. */
+struct sharer *share_sharer_alloc(void)
+{
+    return slab_alloc(&sharer_cache);
+}
+
+/*! Frees SH, if it is not a null pointer.  The frame lock must not be
+    held. */
+void share_sharer_free(struct sharer *sh)
+{
+    if (sh != NULL)
+    {
+        slab_free(&sharer_cache, sh);
+    }
+}
+
+/*! Adds PAGE to the sharers of S, using SH. */
+void share_add(struct share *s, struct sharer *sh, struct page_entry *page)
+{
+    sh->page = page;
+    sh->next = s->sharers;
+    s->sharers = sh;
+}
+
+/*! Removes PAGE from the sharers of S and returns the sharer it used, to
+    be freed once the frame lock is released. */
+struct sharer *share_remove(struct share *s, struct page_entry *page)
+{
+    struct sharer **p, *sh;
+
+    for (p = &(s->sharers); (*p)->page != page; p = &((*p)->next))
+    {
+        ASSERT((*p)->next != NULL);
+    }
+    sh = *p;
+    *p = sh->next;
+    return sh;
+}
+
+/*! Returns the hash of shared page E's inode and offset. */
+static unsigned share_hash(const struct hash_elem *e, void *aux UNUSED)
+{
+    const struct share *s = hash_entry(e, struct share, hash_elem);
+
+    return hash_int((int) ((uintptr_t) s->inode ^ (s->ofs / PGSIZE)));
+}
+
+/*! Orders shared pages by inode, then by offset. */
+static bool share_less(const struct hash_elem *a_, const struct hash_elem *b_,
+                       void *aux UNUSED)
+{
+    const struct share *a = hash_entry(a_, struct share, hash_elem);
+    const struct share *b = hash_entry(b_, struct share, hash_elem);
+
+    if (a->inode != b->inode)
+    {
+        return a->inode < b->inode;
+    }
+    return a->ofs < b->ofs;
+}
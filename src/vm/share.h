@@ -0,0 +1,45 @@
+#ifndef VM_SHARE_H
+#define VM_SHARE_H
+
+#include <hash.h>
+#include <list.h>
+#include <stddef.h>
+#include "filesys/inode.h"
+#include "filesys/off_t.h"
+
+/*! Buckets in the table of shared pages. */
+#define SHARE_HASH_BUCKETS 256
+
+struct frame;
+struct page_entry;
+
+/*! A page entry sharing a page.  Only shared pages need one, so it is kept
+    apart from the page entry. */
+struct sharer {
+    struct page_entry *page;        /*!< Sharing page entry. */
+    struct sharer *next;            /*!< Next sharer of the page, or NULL. */
+};
+
+/*! A read-only page of an executable, shared by every process that maps
+    the same page of the same inode.  The chain of sharers is the reverse
+    map used to unmap the page from all of them. */
+struct share {
+    struct inode *inode;            /*!< Inode the page is read from. */
+    off_t ofs;                      /*!< Offset of the page in the inode. */
+    struct frame *frame;            /*!< Frame holding the page, or NULL. */
+    size_t ref_cnt;                 /*!< Number of sharing page entries. */
+    struct sharer *sharers;         /*!< Sharing page entries. */
+    struct hash_elem hash_elem;     /*!< Element in table of shared pages. */
+    struct list_elem free_elem;     /*!< Element in free list. */
+};
+
+void share_init(struct share *pool, size_t share_cnt, struct list *buckets);
+struct share *share_get(struct inode *, off_t ofs);
+void share_put(struct share *);
+
+struct sharer *share_sharer_alloc(void);
+void share_sharer_free(struct sharer *);
+void share_add(struct share *, struct sharer *, struct page_entry *);
+struct sharer *share_remove(struct share *, struct page_entry *);
+
+#endif /* vm/share.h */
@@ -0,0 +1,298 @@
+/*! \file slab.c
+
+   Object caches for kernel metadata that is allocated on every mapping,
+   such as supplemental page entries.  Each cache keeps its objects in
+   slabs, pinned kernel pages that begin with a struct slab followed by as
+   many objects as fit.  Free objects are chained through their first word,
+   so allocating and freeing are constant time, and the slab of an object
+   is found by rounding its address down to the page.
+
+   Allocating a slab page needs objects from the cache itself (a page entry
+   for the page, and perhaps one for a new page table), so a cache grows
+   before it runs out: once fewer than its reserve of objects are free, the
+   allocating thread adds a page, drawing on the reserve for its own needs.
+   Other threads that find the cache empty meanwhile wait for it.
+
+   A slab that empties out while its cache has more than a slab's worth of
+   other free objects is moved to a pool of spare pages, from which any
+   cache grows before asking palloc for a new page.  Beyond SLAB_SPARE_MAX
+   spare pages, it is freed with palloc instead, unless it was set aside at
+   boot and so never came from palloc. */
+
+#include "vm/slab.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/*! Identifies a page as a slab. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/*! Most spare pages kept for growing caches. */
+#define SLAB_SPARE_MAX 4
+
+/*! Header of a slab page. */
+struct slab {
+    unsigned magic;                 /*!< Detects stray pointers. */
+    struct slab_cache *cache;       /*!< Owning cache, NULL if spare. */
+    bool boot;                      /*!< Set aside at boot, not by palloc. */
+    size_t free_cnt;                /*!< Free objects. */
+    void *free;                     /*!< First free object, or NULL. */
+    struct list_elem elem;          /*!< Element in a cache or spare list. */
+};
+
+/*! All caches, for statistics. */
+static struct list caches;
+
+/*! Slab pages given back by caches, and their lock. */
+static struct list spare_slabs;
+static struct lock spare_lock;
+static size_t spare_cnt;
+static long long spare_freed_cnt;   /*!< Pages freed beyond the spares. */
+
+static void slab_carve(struct slab_cache *, struct slab *, bool boot);
+static bool slab_grow(struct slab_cache *);
+
+/*! Initializes the slab allocator. */
+void slab_init(void)
+{
+    list_init(&caches);
+    list_init(&spare_slabs);
+    lock_init(&spare_lock);
+}
+
+/*! Initializes cache C of objects of OBJ_SIZE bytes named NAME, with the
+    PAGE_CNT pinned pages at PAGES as its first slabs. */
+void slab_cache_init(struct slab_cache *c, const char *name, size_t obj_size,
+                     void *pages, size_t page_cnt)
+{
+    size_t i;
+
+    ASSERT(obj_size >= sizeof(void *));
+    ASSERT(pg_ofs(pages) == 0);
+
+    c->name = name;
+    c->obj_size = ROUND_UP(obj_size, sizeof(void *));
+    c->obj_per_slab = (PGSIZE - sizeof(struct slab)) / c->obj_size;
+    c->reserve = c->obj_per_slab / 2;
+    list_init(&c->partial);
+    list_init(&c->full);
+    c->free_cnt = 0;
+    c->slab_cnt = 0;
+    c->grower = NULL;
+    lock_init(&c->lock);
+    cond_init(&c->grown);
+    c->in_use = 0;
+    c->peak = 0;
+    c->grow_cnt = 0;
+    c->shrink_cnt = 0;
+    list_push_back(&caches, &c->elem);
+
+    ASSERT(c->obj_per_slab > c->reserve);
+    for (i = 0; i < page_cnt; i++)
+    {
+        slab_carve(c, (struct slab *) ((uint8_t *) pages + i * PGSIZE), true);
+    }
+}
+
+/*! Returns a free object from cache C, or a null pointer if the cache is
+    empty and cannot grow. */
+void *slab_alloc(struct slab_cache *c)
+{
+    struct slab *s;
+    void *obj;
+    bool grow;
+
+    lock_acquire(&c->lock);
+    while (c->free_cnt == 0)
+    {
+        /* The grower itself has used up the reserve. */
+        if (c->grower == thread_current())
+        {
+            lock_release(&c->lock);
+            return NULL;
+        }
+        if (c->grower != NULL)
+        {
+            cond_wait(&c->grown, &c->lock);
+            continue;
+        }
+        /* A previous attempt to grow failed; try again now. */
+        c->grower = thread_current();
+        lock_release(&c->lock);
+        if (!slab_grow(c))
+        {
+            return NULL;
+        }
+        lock_acquire(&c->lock);
+    }
+
+    s = list_entry(list_front(&c->partial), struct slab, elem);
+    obj = s->free;
+    s->free = *(void **) obj;
+    c->free_cnt--;
+    if (--s->free_cnt == 0)
+    {
+        list_remove(&s->elem);
+        list_push_back(&c->full, &s->elem);
+    }
+    if (++c->in_use > c->peak)
+    {
+        c->peak = c->in_use;
+    }
+
+    /* Grow ahead of running out, outside the lock, since allocating the
+       page allocates from this cache too. */
+    grow = c->free_cnt < c->reserve && c->grower == NULL;
+    if (grow)
+    {
+        c->grower = thread_current();
+    }
+    lock_release(&c->lock);
+
+    if (grow)
+    {
+        slab_grow(c);
+    }
+    return obj;
+}
+
+/*! Returns OBJ, allocated from cache C, to the cache. */
+void slab_free(struct slab_cache *c, void *obj)
+{
+    struct slab *s = pg_round_down(obj);
+    bool release = false;
+
+    ASSERT(s->magic == SLAB_MAGIC);
+    ASSERT(s->cache == c);
+
+    lock_acquire(&c->lock);
+    *(void **) obj = s->free;
+    s->free = obj;
+    c->free_cnt++;
+    c->in_use--;
+    if (s->free_cnt++ == 0)
+    {
+        list_remove(&s->elem);
+        list_push_front(&c->partial, &s->elem);
+    }
+
+    /* Give back an empty slab if the cache keeps more than a slab's worth
+       of free objects without it. */
+    if (s->free_cnt == c->obj_per_slab &&
+        c->free_cnt - s->free_cnt >= c->reserve + c->obj_per_slab)
+    {
+        list_remove(&s->elem);
+        c->free_cnt -= s->free_cnt;
+        c->slab_cnt--;
+        c->shrink_cnt++;
+        release = true;
+    }
+    lock_release(&c->lock);
+
+    if (release)
+    {
+        s->cache = NULL;
+        lock_acquire(&spare_lock);
+        if (spare_cnt < SLAB_SPARE_MAX || s->boot)
+        {
+            list_push_back(&spare_slabs, &s->elem);
+            spare_cnt++;
+            s = NULL;
+        }
+        else
+        {
+            spare_freed_cnt++;
+        }
+        lock_release(&spare_lock);
+
+        /* Freeing the page frees its page entry, perhaps into this cache,
+           so no lock may be held. */
+        if (s != NULL)
+        {
+            palloc_free_page(s);
+        }
+    }
+}
+
+/*! Prints statistics about each cache. */
+void slab_print_stats(void)
+{
+    struct list_elem *e;
+
+    for (e = list_begin(&caches); e != list_end(&caches); e = list_next(e))
+    {
+        struct slab_cache *c = list_entry(e, struct slab_cache, elem);
+
+        printf("Slab %s: %zu in use (peak %zu), %zu slabs, "
+               "%lld grown, %lld given back\n",
+               c->name, c->in_use, c->peak, c->slab_cnt,
+               c->grow_cnt, c->shrink_cnt);
+    }
+    printf("Slab: %zu spare pages, %lld freed\n", spare_cnt, spare_freed_cnt);
+}
+
+/*! Makes page S into an empty slab of cache C, marked as set aside at boot
+    if BOOT is true.  The cache lock must not be held, since the page may
+    not be in memory yet. */
+static void slab_carve(struct slab_cache *c, struct slab *s, bool boot)
+{
+    uint8_t *obj = (uint8_t *) (s + 1);
+    size_t i;
+
+    s->magic = SLAB_MAGIC;
+    s->cache = c;
+    s->boot = boot;
+    s->free = NULL;
+    s->free_cnt = c->obj_per_slab;
+    for (i = 0; i < c->obj_per_slab; i++)
+    {
+        *(void **) obj = s->free;
+        s->free = obj;
+        obj += c->obj_size;
+    }
+
+    lock_acquire(&c->lock);
+    list_push_back(&c->partial, &s->elem);
+    c->free_cnt += s->free_cnt;
+    c->slab_cnt++;
+    lock_release(&c->lock);
+}
+
+/*! Adds a slab to cache C, taking a spare page if there is one.  The
+    calling thread must be C's grower.  Returns true if successful. */
+static bool slab_grow(struct slab_cache *c)
+{
+    struct slab *s = NULL;
+    bool boot = false;
+
+    lock_acquire(&spare_lock);
+    if (!list_empty(&spare_slabs))
+    {
+        s = list_entry(list_pop_front(&spare_slabs), struct slab, elem);
+        boot = s->boot;
+        spare_cnt--;
+    }
+    lock_release(&spare_lock);
+    if (s == NULL)
+    {
+        s = palloc_get_page(PAL_PAGING | PAL_PIN);
+    }
+
+    if (s != NULL)
+    {
+        slab_carve(c, s, boot);
+    }
+    lock_acquire(&c->lock);
+    if (s != NULL)
+    {
+        c->grow_cnt++;
+    }
+    c->grower = NULL;
+    cond_broadcast(&c->grown, &c->lock);
+    lock_release(&c->lock);
+    return s != NULL;
+}
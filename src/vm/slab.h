@@ -0,0 +1,43 @@
+#ifndef VM_SLAB_H
+#define VM_SLAB_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "threads/synch.h"
+
+struct thread;
+
+/*! A cache of equal-sized kernel objects, carved out of pinned kernel
+    pages.  The cache grows a page at a time once fewer than RESERVE
+    objects are free, and gives back pages that have emptied out while it
+    has plenty of free objects. */
+struct slab_cache {
+    const char *name;               /*!< Name, for statistics. */
+    size_t obj_size;                /*!< Size of each object. */
+    size_t obj_per_slab;            /*!< Objects in each slab page. */
+    size_t reserve;                 /*!< Free objects kept for growing. */
+    struct list partial;            /*!< Slabs with free objects. */
+    struct list full;               /*!< Slabs with none free. */
+    size_t free_cnt;                /*!< Free objects in partial slabs. */
+    size_t slab_cnt;                /*!< Slabs in the cache. */
+    struct thread *grower;          /*!< Thread adding a slab, or NULL. */
+    struct lock lock;               /*!< Protects the cache. */
+    struct condition grown;         /*!< Signaled when growing finishes. */
+    struct list_elem elem;          /*!< Element in list of caches. */
+
+    /* Statistics. */
+    size_t in_use;                  /*!< Objects allocated. */
+    size_t peak;                    /*!< Most objects ever allocated. */
+    long long grow_cnt;             /*!< Slabs added. */
+    long long shrink_cnt;           /*!< Slabs given back. */
+};
+
+void slab_init(void);
+void slab_cache_init(struct slab_cache *, const char *name, size_t obj_size,
+                     void *pages, size_t page_cnt);
+void *slab_alloc(struct slab_cache *);
+void slab_free(struct slab_cache *, void *);
+void slab_print_stats(void);
+
+#endif /* vm/slab.h */
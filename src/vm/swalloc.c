@@ -1,10 +1,18 @@
 /*! \file swalloc.c
 
-   Swap allocator. */
+   Swap allocator.
+
+   Swap slots are tracked in a bitmap and handed out in runs of consecutive
+   slots, so that pages evicted together land next to each other on disk and
+   move in a single multi-sector transfer.  The search for a run starts
+   where the last one ended, which keeps successive evictions close
+   together. */
 
 #include "swalloc.h"
 #include "falloc.h"
 #include "threads/thread.h"
+#include <bitmap.h>
+#include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include "devices/block.h"
@@ -15,11 +23,23 @@
 
 #define PAGE_SECTORS    PGSIZE / BLOCK_SECTOR_SIZE
 
-// Need a list of swap structs
-static struct list *open_swap_list;
+/*! Used swap slots. */
+static struct bitmap *swap_map;
 
 static struct swap *swap_list;
 
+static block_sector_t swap_sector(const struct swap *);
+static size_t swap_take(struct thread *, size_t cnt, struct swap **);
+
+/*! Protects swap_map, swap_next, swap_free_cnt and the swap entries. */
+static struct lock swap_lock;
+
+/*! Slot at which to start looking for a free run. */
+static size_t swap_next;
+
+/*! Number of free slots. */
+static size_t swap_free_cnt;
+
 struct block *swap_disk;
 static uint32_t swap_slots;
 
@@ -28,52 +48,166 @@ static uint32_t swap_slots;
 void swalloc_init(void)
 {
     uint32_t i;
+    size_t map_size;
 
+    lock_init(&swap_lock);
+    swap_next = 0;
+
+    /* Without a swap device nothing can be swapped out. */
     swap_disk = block_get_role(BLOCK_SWAP);
+    if (swap_disk == NULL)
+    {
+        swap_slots = 0;
+        return;
+    }
     swap_slots = block_size(swap_disk) / PAGE_SECTORS;
+    swap_free_cnt = swap_slots;
 
-    /* Initialize swap table */
+    /* Initialize swap table and bitmap.  Both are touched here, so that
+       they are in frames before eviction, which holds the frame lock,
+       needs them. */
     uint32_t num_pages_used = sizeof(struct swap) * swap_slots;
     num_pages_used = (uint32_t) pg_round_up((void *) num_pages_used) / PGSIZE;
+    map_size = bitmap_buf_size(swap_slots);
 
-    /* Get pages for swap table */
+    /* Get pages for swap table and bitmap */
     swap_list = palloc_get_multiple(PAL_ASSERT | PAL_PAGING | PAL_ZERO, num_pages_used);
+    swap_map = bitmap_create_in_buf(swap_slots,
+                                    palloc_get_multiple(PAL_ASSERT | PAL_PAGING,
+                                                        DIV_ROUND_UP(map_size, PGSIZE)),
+                                    map_size);
 
-    /* Initialize list */
-    list_init(open_swap_list);
     /* Initialize swap entries */
     for (i = 0; i < swap_slots; ++i)
     {
-        swap_list[i].start_sector = i * PAGE_SECTORS;
-        swap_list[i].in_use = false;
-        list_push_back(open_swap_list, &(swap_list[i].open_elem));
+        swap_list[i].owner = NULL;
+        swap_list[i].page = NULL;
     }
 }
 
+/*! Returns true if there is a swap device to write pages to. */
+bool swalloc_has_swap(void)
+{
+    return swap_slots > 0;
+}
+
 /*! Obtains a single free swap and returns its entry. The swap is marked in use,
-    and associated into the current process list.
+    and associated into the process list of OWNER.
     If no swaps are available, the kernel panics. */
-struct swap *swalloc_get_swap()
+struct swap *swalloc_get_swap(struct thread *owner)
 {
-    struct list_elem *elem;
     struct swap *swap_entry;
 
+    swalloc_get_swaps(owner, 1, &swap_entry);
+    return swap_entry;
+}
+
+/*! Obtains a single free swap for OWNER like swalloc_get_swap(), but only
+    while more than RESERVE slots are free, so that slots are left for
+    eviction.  Returns NULL instead of panicking if there is no such slot
+    or no swap device. */
+struct swap *swalloc_try_get_swap(struct thread *owner, size_t reserve)
+{
+    struct swap *swap_entry = NULL;
+
+    ASSERT(owner != NULL);
+
+    if (swap_map == NULL)
+    {
+        return NULL;
+    }
+
+    lock_acquire(&swap_lock);
+    if (swap_free_cnt > reserve && swap_take(owner, 1, &swap_entry) == 0)
+    {
+        swap_entry = NULL;
+    }
+    lock_release(&swap_lock);
+    return swap_entry;
+}
+
+/*! Obtains a run of up to CNT consecutive free swaps for OWNER, storing the
+    entry of the first in *FIRST and returning how many were obtained.  CNT
+    is halved until a run that long is free.  If no swaps are available, the
+    kernel panics. */
+size_t swalloc_get_swaps(struct thread *owner, size_t cnt,
+                         struct swap **first)
+{
+    ASSERT(cnt > 0);
+    ASSERT(owner != NULL);
+
+    if (swap_map == NULL)
+    {
+        PANIC("swalloc_get: no swap device");
+    }
+
+    lock_acquire(&swap_lock);
+    cnt = swap_take(owner, cnt, first);
+
     /* If no empty swap slots, panic system */
-    if (list_empty(open_swap_list))
+    if (cnt == 0)
     {
         PANIC("swalloc_get: out of swap slots");
     }
-    /* Otherwise, get an open swap. */
-    elem = list_pop_front(open_swap_list);
+    lock_release(&swap_lock);
+    return cnt;
+}
 
-    /* Remove swap from list of open swaps. */
-    swap_entry = list_entry(elem, struct swap, open_elem);
-    /* Mark as in use */
-    swap_entry->in_use = true;
-    /* Add to process list. */
-    list_push_back(&(thread_current()->swaps), &(swap_entry->process_elem));
+/*! Takes a run of up to CNT consecutive free swaps for OWNER, halving CNT
+    until a run that long is free, stores the entry of the first in *FIRST
+    and returns how many were taken, or 0 if no slot is free.  Must be
+    called with the swap lock held. */
+static size_t swap_take(struct thread *owner, size_t cnt,
+                        struct swap **first)
+{
+    size_t slot = BITMAP_ERROR;
+    size_t i;
 
-    return swap_entry;
+    for (; cnt > 0; cnt /= 2)
+    {
+        /* Look past the last run first, then wrap around. */
+        slot = bitmap_scan_and_flip(swap_map, swap_next, cnt, false);
+        if (slot == BITMAP_ERROR)
+        {
+            slot = bitmap_scan_and_flip(swap_map, 0, cnt, false);
+        }
+        if (slot != BITMAP_ERROR)
+        {
+            break;
+        }
+    }
+
+    if (slot == BITMAP_ERROR)
+    {
+        return 0;
+    }
+    swap_next = slot + cnt;
+    swap_free_cnt -= cnt;
+
+    /* Mark as in use and add to process list. */
+    for (i = 0; i < cnt; i++)
+    {
+        struct swap *swap_entry = &swap_list[slot + i];
+        swap_entry->owner = owner;
+        swap_entry->page = NULL;
+        list_push_back(&(owner->swaps), &(swap_entry->process_elem));
+    }
+
+    *first = &swap_list[slot];
+    return cnt;
+}
+
+/*! Returns the entry of the slot after SWAP_ENTRY if it is in use, or NULL
+    if it is free or SWAP_ENTRY is the last slot. */
+struct swap *swalloc_next_swap(struct swap *swap_entry)
+{
+    struct swap *next = swap_entry + 1;
+
+    if (next >= swap_list + swap_slots || next->owner == NULL)
+    {
+        return NULL;
+    }
+    return next;
 }
 
 /*! Frees the swap at swap. */
@@ -81,37 +215,65 @@ struct swap *swalloc_get_swap()
 void swalloc_free_swap(struct swap *swap_entry)
 {
     /* If it wasn't allocated, just return. */
-    if (!swap_entry->in_use)
+    if (swap_entry->owner == NULL)
     {
         return;
     }
 
-    /* Add swap struct back to open list. */
-    list_push_back(open_swap_list, &(swap_entry->open_elem));
+    lock_acquire(&swap_lock);
+    /* Mark slot free again. */
+    bitmap_reset(swap_map, swap_entry - swap_list);
+    swap_free_cnt++;
     /* Remove from user's list */
     list_remove(&(swap_entry->process_elem));
     /* Mark as unused */
-    swap_entry->in_use = false;
+    swap_entry->owner = NULL;
+    swap_entry->page = NULL;
+    lock_release(&swap_lock);
 }
 
 /*! Takes a page and writes it into the given swap entry file. */
 void swap_write_page(struct swap* swap_entry, void *upage)
 {
-    ASSERT(swap_entry->in_use);
-    uint32_t i;
-    for (i = 0; i < PAGE_SECTORS; i++)
-    {
-        block_write(swap_disk, swap_entry->start_sector + i, upage + i * BLOCK_SECTOR_SIZE);
-    }
+    swap_write_pages(swap_entry, 1, upage);
 }
 
 /*! Writes a swap file back to the given page */
 void swap_read_page(struct swap* swap_entry, void *upage)
 {
-    ASSERT(swap_entry->in_use);
-    uint32_t i;
-    for (i = 0; i < PAGE_SECTORS; i++)
+    swap_read_pages(swap_entry, 1, upage);
+}
+
+/*! Writes the CNT pages at PAGES into the CNT consecutive swaps starting at
+    SWAP_ENTRY, in one device command. */
+void swap_write_pages(struct swap *swap_entry, size_t cnt, const void *pages)
+{
+    size_t i;
+
+    for (i = 0; i < cnt; i++)
+    {
+        ASSERT(swap_entry[i].owner != NULL);
+    }
+    block_write_multiple(swap_disk, swap_sector(swap_entry),
+                         cnt * PAGE_SECTORS, pages);
+}
+
+/*! Reads the CNT consecutive swaps starting at SWAP_ENTRY into the CNT
+    pages at PAGES, in one device command. */
+void swap_read_pages(struct swap *swap_entry, size_t cnt, void *pages)
+{
+    size_t i;
+
+    for (i = 0; i < cnt; i++)
     {
-        block_read(swap_disk, swap_entry->start_sector + i, upage + i * BLOCK_SECTOR_SIZE);
+        ASSERT(swap_entry[i].owner != NULL);
     }
+    block_read_multiple(swap_disk, swap_sector(swap_entry),
+                        cnt * PAGE_SECTORS, pages);
+}
+
+/*! Returns the first sector of the slot of SWAP_ENTRY. */
+static block_sector_t swap_sector(const struct swap *swap_entry)
+{
+    return (swap_entry - swap_list) * PAGE_SECTORS;
 }
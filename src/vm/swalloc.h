@@ -5,20 +5,31 @@
 #include <list.h>
 #include "threads/palloc.h"
 #include "threads/thread.h"
+
+/*! Most pages written to or read from swap in one device command. */
+#define SWAP_CLUSTER    8
  
-/*! A swap entry struct. */
+/*! A swap entry struct.  Entries are kept in slot order, so the entries of
+    a cluster of slots are consecutive, and the sectors of a slot follow
+    from its entry's place in the table. */
 struct swap {
-    uint32_t start_sector;          /*!< Starting sector of swap. */
-    bool in_use;                    /*!< Marks a swap as used or open. */
+    struct thread *owner;           /*!< Process whose page is held, NULL if
+                                         the slot is free. */
+    struct page_entry *page;        /*!< Page held, or NULL. */
     struct list_elem process_elem;  /*!< List element for process. */
-    struct list_elem open_elem;     /*!< List element for open list. */
 };
 
 void swalloc_init(void);
-struct swap *swalloc_get_swap(void);
+bool swalloc_has_swap(void);
+struct swap *swalloc_get_swap(struct thread *);
+struct swap *swalloc_try_get_swap(struct thread *, size_t reserve);
+size_t swalloc_get_swaps(struct thread *, size_t cnt, struct swap **);
+struct swap *swalloc_next_swap(struct swap *);
 void swalloc_free_swap(struct swap *);
 
 void swap_write_page(struct swap*, void *);
 void swap_read_page(struct swap*, void *);
+void swap_write_pages(struct swap*, size_t cnt, const void *);
+void swap_read_pages(struct swap*, size_t cnt, void *);
 
 #endif /* vm/swalloc.h */
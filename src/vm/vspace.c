@@ -0,0 +1,574 @@
+/*! \file vspace.c
+
+   Free virtual address ranges.
+
+   Each address space keeps its unmapped pages as maximal runs of free
+   pages.  Every run is in two AVL trees: one ordered by address, whose
+   nodes also record the largest run in their subtree, and one ordered by
+   size.  The first finds the lowest run of at least N pages and the
+   second the smallest such run, each in O(log n) time for n runs.
+   Mapping pages splits a run, and unmapping them merges it with its
+   neighbours.
+
+   Runs come from a slab cache of pinned pages, since they are used while
+   handling page faults and so must never fault themselves.  Growing the
+   cache maps a kernel page, which takes a run from the kernel address
+   space, so runs are allocated and freed with the trees unlocked: an
+   operation that may need a new run allocates one first, and one that
+   empties a run frees it afterwards.  If the cache cannot grow, the
+   operation fails. */
+
+#include "vspace.h"
+#include <debug.h>
+#include <stddef.h>
+#include "threads/synch.h"
+#include "vm/slab.h"
+
+/*! Cache of ranges. */
+static struct slab_cache range_cache;
+
+/*! Protects the trees of every address space. */
+static struct lock vspace_lock;
+
+static struct vspace_range *range_alloc(void);
+static void range_free(struct vspace_range *);
+static void range_insert(struct vspace *, struct vspace_range *);
+static void range_remove(struct vspace *, struct vspace_range *);
+static struct vspace_range *range_floor(struct vspace *, uintptr_t page);
+static struct vspace_range *range_ceil(struct vspace *, uintptr_t page);
+static bool range_less(const struct vspace_range *,
+                       const struct vspace_range *, enum vspace_index);
+
+static int tree_height(const struct vspace_range *, enum vspace_index);
+static void tree_update(struct vspace_range *, enum vspace_index);
+static struct vspace_range *tree_rotate_left(struct vspace_range *,
+                                             enum vspace_index);
+static struct vspace_range *tree_rotate_right(struct vspace_range *,
+                                              enum vspace_index);
+static struct vspace_range *tree_rebalance(struct vspace_range *,
+                                           enum vspace_index);
+static struct vspace_range *tree_insert(struct vspace_range *root,
+                                        struct vspace_range *,
+                                        enum vspace_index);
+static struct vspace_range *tree_remove(struct vspace_range *root,
+                                        struct vspace_range *,
+                                        enum vspace_index);
+static struct vspace_range *tree_remove_min(struct vspace_range *root,
+                                            struct vspace_range **min,
+                                            enum vspace_index);
+static void tree_free(struct vspace_range *);
+
+/*! Initializes the range allocator, with the PAGE_CNT pinned pages at
+    PAGES as the first slabs of ranges.  The slab allocator must be
+    initialized. */
+void vspace_init(void *pages, size_t page_cnt)
+{
+    lock_init(&vspace_lock);
+    slab_cache_init(&range_cache, "vspace_range",
+                    sizeof(struct vspace_range), pages, page_cnt);
+}
+
+/*! Initializes VS as an address space in which the CNT pages starting at
+    page number START are free.  Returns false, leaving VS with no free
+    pages, if no range is left to hold them. */
+bool vspace_create(struct vspace *vs, uintptr_t start, size_t cnt)
+{
+    struct vspace_range *r;
+
+    vs->root[VSPACE_BY_ADDR] = NULL;
+    vs->root[VSPACE_BY_SIZE] = NULL;
+    if (cnt == 0)
+    {
+        return true;
+    }
+    r = range_alloc();
+    if (r == NULL)
+    {
+        return false;
+    }
+    r->start = start;
+    r->cnt = cnt;
+    lock_acquire(&vspace_lock);
+    range_insert(vs, r);
+    lock_release(&vspace_lock);
+    return true;
+}
+
+/*! Frees the ranges of VS.  VS is left with no free pages. */
+void vspace_destroy(struct vspace *vs)
+{
+    struct vspace_range *root;
+
+    lock_acquire(&vspace_lock);
+    root = vs->root[VSPACE_BY_ADDR];
+    vs->root[VSPACE_BY_ADDR] = NULL;
+    vs->root[VSPACE_BY_SIZE] = NULL;
+    lock_release(&vspace_lock);
+    tree_free(root);
+}
+
+/*! Finds the lowest run of at least CNT free pages in VS.  If there is one,
+    stores its first page number in *START and returns true. */
+bool vspace_first_fit(struct vspace *vs, size_t cnt, uintptr_t *start)
+{
+    struct vspace_range *r;
+    bool found = false;
+
+    lock_acquire(&vspace_lock);
+    r = vs->root[VSPACE_BY_ADDR];
+    if (r != NULL && r->max_cnt >= cnt)
+    {
+        /* Some run below R is long enough, so keep to the lowest one. */
+        for (;;)
+        {
+            struct vspace_range *left = r->left[VSPACE_BY_ADDR];
+            if (left != NULL && left->max_cnt >= cnt)
+            {
+                r = left;
+            }
+            else if (r->cnt >= cnt)
+            {
+                break;
+            }
+            else
+            {
+                r = r->right[VSPACE_BY_ADDR];
+            }
+        }
+        *start = r->start;
+        found = true;
+    }
+    lock_release(&vspace_lock);
+    return found;
+}
+
+/*! Finds the shortest run of at least CNT free pages in VS, the lowest of
+    several equally short ones.  If there is one, stores its first page
+    number in *START and returns true. */
+bool vspace_best_fit(struct vspace *vs, size_t cnt, uintptr_t *start)
+{
+    struct vspace_range *r, *best = NULL;
+
+    lock_acquire(&vspace_lock);
+    for (r = vs->root[VSPACE_BY_SIZE]; r != NULL; )
+    {
+        if (r->cnt >= cnt)
+        {
+            best = r;
+            r = r->left[VSPACE_BY_SIZE];
+        }
+        else
+        {
+            r = r->right[VSPACE_BY_SIZE];
+        }
+    }
+    if (best != NULL)
+    {
+        *start = best->start;
+    }
+    lock_release(&vspace_lock);
+    return best != NULL;
+}
+
+/*! Returns true if the CNT pages starting at page number START are all
+    free in VS. */
+bool vspace_is_free(struct vspace *vs, uintptr_t start, size_t cnt)
+{
+    struct vspace_range *r;
+    bool free;
+
+    lock_acquire(&vspace_lock);
+    r = range_floor(vs, start);
+    free = r != NULL && start + cnt <= r->start + r->cnt;
+    lock_release(&vspace_lock);
+    return free;
+}
+
+/*! Marks the CNT pages starting at page number START as used in VS,
+    splitting the run that holds them.  Returns false, changing nothing,
+    if any of them is not free, or if the run must be split in two and no
+    range is left for the second part. */
+bool vspace_take(struct vspace *vs, uintptr_t start, size_t cnt)
+{
+    struct vspace_range *spare = range_alloc();
+    struct vspace_range *r, *unused = NULL;
+    bool taken = false;
+    uintptr_t end = 0;
+
+    lock_acquire(&vspace_lock);
+    r = range_floor(vs, start);
+    if (r != NULL && start + cnt <= r->start + r->cnt)
+    {
+        end = r->start + r->cnt;
+        taken = spare != NULL || r->start == start || start + cnt == end;
+    }
+    if (taken)
+    {
+        /* Keep whatever is left on either side of the taken pages. */
+        range_remove(vs, r);
+        if (start + cnt < end)
+        {
+            spare->start = start + cnt;
+            spare->cnt = end - (start + cnt);
+            range_insert(vs, spare);
+            spare = NULL;
+        }
+        if (r->start < start)
+        {
+            r->cnt = start - r->start;
+            range_insert(vs, r);
+        }
+        else
+        {
+            unused = r;
+        }
+    }
+    lock_release(&vspace_lock);
+
+    range_free(spare);
+    range_free(unused);
+    return taken;
+}
+
+/*! Marks the CNT pages starting at page number START, which must be in use,
+    as free in VS, merging them with the free runs on either side.  Returns
+    false, changing nothing, if they join neither and no range is left to
+    hold them. */
+bool vspace_give(struct vspace *vs, uintptr_t start, size_t cnt)
+{
+    struct vspace_range *spare = range_alloc();
+    struct vspace_range *prev, *next, *r = NULL, *unused = NULL;
+
+    lock_acquire(&vspace_lock);
+    prev = range_floor(vs, start);
+    next = range_ceil(vs, start);
+    ASSERT(prev == NULL || prev->start + prev->cnt <= start);
+    ASSERT(next == NULL || start + cnt <= next->start);
+
+    if (prev != NULL && prev->start + prev->cnt == start)
+    {
+        range_remove(vs, prev);
+        prev->cnt += cnt;
+        r = prev;
+    }
+    else if (next != NULL && next->start == start + cnt)
+    {
+        range_remove(vs, next);
+        next->start = start;
+        next->cnt += cnt;
+        r = next;
+        next = NULL;
+    }
+    else if (spare != NULL)
+    {
+        spare->start = start;
+        spare->cnt = cnt;
+        r = spare;
+        spare = NULL;
+    }
+    if (r != NULL && next != NULL && next->start == start + cnt)
+    {
+        range_remove(vs, next);
+        r->cnt += next->cnt;
+        unused = next;
+    }
+    if (r != NULL)
+    {
+        range_insert(vs, r);
+    }
+    lock_release(&vspace_lock);
+
+    range_free(spare);
+    range_free(unused);
+    return r != NULL;
+}
+
+/*! Finds the lowest run of used pages in VS from page number *START up to
+    page number END.  If there is one, stores its first page number in
+    *START and returns its length, or else returns 0. */
+size_t vspace_used_run(struct vspace *vs, uintptr_t *start, uintptr_t end)
+{
+    struct vspace_range *r;
+    uintptr_t page = *start;
+    size_t cnt = 0;
+
+    lock_acquire(&vspace_lock);
+    /* Skip the free run holding PAGE.  Free runs are maximal, so the page
+       after it is used. */
+    r = range_floor(vs, page);
+    if (r != NULL && page < r->start + r->cnt)
+    {
+        page = r->start + r->cnt;
+    }
+    if (page < end)
+    {
+        r = range_ceil(vs, page);
+        cnt = (r != NULL && r->start < end ? r->start : end) - page;
+        *start = page;
+    }
+    lock_release(&vspace_lock);
+    return cnt;
+}
+
+/*! Returns a new range, or a null pointer if none can be allocated.  The
+    trees must not be locked. */
+static struct vspace_range *range_alloc(void)
+{
+    ASSERT(!lock_held_by_current_thread(&vspace_lock));
+    return slab_alloc(&range_cache);
+}
+
+/*! Frees R, if it is not a null pointer.  The trees must not be locked. */
+static void range_free(struct vspace_range *r)
+{
+    ASSERT(!lock_held_by_current_thread(&vspace_lock));
+    if (r != NULL)
+    {
+        slab_free(&range_cache, r);
+    }
+}
+
+/*! Adds R to both trees of VS. */
+static void range_insert(struct vspace *vs, struct vspace_range *r)
+{
+    vs->root[VSPACE_BY_ADDR] = tree_insert(vs->root[VSPACE_BY_ADDR], r,
+                                           VSPACE_BY_ADDR);
+    vs->root[VSPACE_BY_SIZE] = tree_insert(vs->root[VSPACE_BY_SIZE], r,
+                                           VSPACE_BY_SIZE);
+}
+
+/*! Removes R from both trees of VS. */
+static void range_remove(struct vspace *vs, struct vspace_range *r)
+{
+    vs->root[VSPACE_BY_ADDR] = tree_remove(vs->root[VSPACE_BY_ADDR], r,
+                                           VSPACE_BY_ADDR);
+    vs->root[VSPACE_BY_SIZE] = tree_remove(vs->root[VSPACE_BY_SIZE], r,
+                                           VSPACE_BY_SIZE);
+}
+
+/*! Returns the run of VS starting last at or before PAGE, or NULL. */
+static struct vspace_range *range_floor(struct vspace *vs, uintptr_t page)
+{
+    struct vspace_range *r = vs->root[VSPACE_BY_ADDR];
+    struct vspace_range *best = NULL;
+
+    while (r != NULL)
+    {
+        if (r->start <= page)
+        {
+            best = r;
+            r = r->right[VSPACE_BY_ADDR];
+        }
+        else
+        {
+            r = r->left[VSPACE_BY_ADDR];
+        }
+    }
+    return best;
+}
+
+/*! Returns the run of VS starting first at or after PAGE, or NULL. */
+static struct vspace_range *range_ceil(struct vspace *vs, uintptr_t page)
+{
+    struct vspace_range *r = vs->root[VSPACE_BY_ADDR];
+    struct vspace_range *best = NULL;
+
+    while (r != NULL)
+    {
+        if (r->start >= page)
+        {
+            best = r;
+            r = r->left[VSPACE_BY_ADDR];
+        }
+        else
+        {
+            r = r->right[VSPACE_BY_ADDR];
+        }
+    }
+    return best;
+}
+
+/*! Returns true if A comes before B in index IDX.  Runs never overlap, so
+    their first pages tell them apart. */
+static bool range_less(const struct vspace_range *a,
+                       const struct vspace_range *b, enum vspace_index idx)
+{
+    if (idx == VSPACE_BY_SIZE && a->cnt != b->cnt)
+    {
+        return a->cnt < b->cnt;
+    }
+    return a->start < b->start;
+}
+
+/*! Returns the height of the subtree R in index IDX. */
+static int tree_height(const struct vspace_range *r, enum vspace_index idx)
+{
+    return r != NULL ? r->height[idx] : 0;
+}
+
+/*! Recomputes the height of R in index IDX from its children, and in the
+    address index the largest run below it. */
+static void tree_update(struct vspace_range *r, enum vspace_index idx)
+{
+    struct vspace_range *left = r->left[idx];
+    struct vspace_range *right = r->right[idx];
+    int lh = tree_height(left, idx);
+    int rh = tree_height(right, idx);
+
+    r->height[idx] = (lh > rh ? lh : rh) + 1;
+    if (idx == VSPACE_BY_ADDR)
+    {
+        r->max_cnt = r->cnt;
+        if (left != NULL && left->max_cnt > r->max_cnt)
+        {
+            r->max_cnt = left->max_cnt;
+        }
+        if (right != NULL && right->max_cnt > r->max_cnt)
+        {
+            r->max_cnt = right->max_cnt;
+        }
+    }
+}
+
+/*! Rotates the subtree R left in index IDX and returns its new root. */
+static struct vspace_range *tree_rotate_left(struct vspace_range *r,
+                                             enum vspace_index idx)
+{
+    struct vspace_range *p = r->right[idx];
+
+    r->right[idx] = p->left[idx];
+    p->left[idx] = r;
+    tree_update(r, idx);
+    tree_update(p, idx);
+    return p;
+}
+
+/*! Rotates the subtree R right in index IDX and returns its new root. */
+static struct vspace_range *tree_rotate_right(struct vspace_range *r,
+                                              enum vspace_index idx)
+{
+    struct vspace_range *p = r->left[idx];
+
+    r->left[idx] = p->right[idx];
+    p->right[idx] = r;
+    tree_update(r, idx);
+    tree_update(p, idx);
+    return p;
+}
+
+/*! Restores the AVL balance of the subtree R in index IDX, whose children
+    are balanced and differ in height by at most 2, and returns its new
+    root. */
+static struct vspace_range *tree_rebalance(struct vspace_range *r,
+                                           enum vspace_index idx)
+{
+    int balance;
+
+    tree_update(r, idx);
+    balance = tree_height(r->left[idx], idx) - tree_height(r->right[idx], idx);
+    if (balance > 1)
+    {
+        struct vspace_range *left = r->left[idx];
+        if (tree_height(left->left[idx], idx) <
+            tree_height(left->right[idx], idx))
+        {
+            r->left[idx] = tree_rotate_left(left, idx);
+        }
+        return tree_rotate_right(r, idx);
+    }
+    if (balance < -1)
+    {
+        struct vspace_range *right = r->right[idx];
+        if (tree_height(right->right[idx], idx) <
+            tree_height(right->left[idx], idx))
+        {
+            r->right[idx] = tree_rotate_right(right, idx);
+        }
+        return tree_rotate_left(r, idx);
+    }
+    return r;
+}
+
+/*! Inserts R into the subtree ROOT of index IDX and returns its new root. */
+static struct vspace_range *tree_insert(struct vspace_range *root,
+                                        struct vspace_range *r,
+                                        enum vspace_index idx)
+{
+    if (root == NULL)
+    {
+        r->left[idx] = r->right[idx] = NULL;
+        tree_update(r, idx);
+        return r;
+    }
+    if (range_less(r, root, idx))
+    {
+        root->left[idx] = tree_insert(root->left[idx], r, idx);
+    }
+    else
+    {
+        root->right[idx] = tree_insert(root->right[idx], r, idx);
+    }
+    return tree_rebalance(root, idx);
+}
+
+/*! Removes R from the subtree ROOT of index IDX and returns its new
+    root. */
+static struct vspace_range *tree_remove(struct vspace_range *root,
+                                        struct vspace_range *r,
+                                        enum vspace_index idx)
+{
+    ASSERT(root != NULL);
+
+    if (root == r)
+    {
+        struct vspace_range *left = r->left[idx];
+        struct vspace_range *right = r->right[idx];
+        struct vspace_range *min;
+
+        /* Replace R by the least range to its right, if any. */
+        if (right == NULL)
+        {
+            return left;
+        }
+        right = tree_remove_min(right, &min, idx);
+        min->left[idx] = left;
+        min->right[idx] = right;
+        return tree_rebalance(min, idx);
+    }
+    if (range_less(r, root, idx))
+    {
+        root->left[idx] = tree_remove(root->left[idx], r, idx);
+    }
+    else
+    {
+        root->right[idx] = tree_remove(root->right[idx], r, idx);
+    }
+    return tree_rebalance(root, idx);
+}
+
+/*! Removes the least range from the subtree ROOT of index IDX, storing it
+    in *MIN, and returns the subtree's new root. */
+static struct vspace_range *tree_remove_min(struct vspace_range *root,
+                                            struct vspace_range **min,
+                                            enum vspace_index idx)
+{
+    if (root->left[idx] == NULL)
+    {
+        *min = root;
+        return root->right[idx];
+    }
+    root->left[idx] = tree_remove_min(root->left[idx], min, idx);
+    return tree_rebalance(root, idx);
+}
+
+/*! Frees every range in the address-index subtree R, which is no longer
+    in any address space. */
+static void tree_free(struct vspace_range *r)
+{
+    if (r != NULL)
+    {
+        tree_free(r->left[VSPACE_BY_ADDR]);
+        tree_free(r->right[VSPACE_BY_ADDR]);
+        range_free(r);
+    }
+}
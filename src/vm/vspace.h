@@ -0,0 +1,42 @@
+#ifndef VM_VSPACE_H
+#define VM_VSPACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*! Indexes over the free ranges of an address space. */
+enum vspace_index {
+    VSPACE_BY_ADDR,                 /*!< By first page. */
+    VSPACE_BY_SIZE,                 /*!< By page count, then first page. */
+    VSPACE_INDEX_CNT
+};
+
+/*! A run of free virtual pages, in both indexes of its address space. */
+struct vspace_range {
+    uintptr_t start;                /*!< First page number. */
+    size_t cnt;                     /*!< Number of pages. */
+    size_t max_cnt;                 /*!< Largest cnt in by-address subtree. */
+    struct vspace_range *left[VSPACE_INDEX_CNT];    /*!< Left children. */
+    struct vspace_range *right[VSPACE_INDEX_CNT];   /*!< Right children. */
+    int height[VSPACE_INDEX_CNT];   /*!< Subtree heights. */
+};
+
+/*! The free pages of an address space. */
+struct vspace {
+    struct vspace_range *root[VSPACE_INDEX_CNT];    /*!< AVL tree roots. */
+};
+
+void vspace_init(void *pages, size_t page_cnt);
+
+bool vspace_create(struct vspace *, uintptr_t start, size_t cnt);
+void vspace_destroy(struct vspace *);
+
+bool vspace_first_fit(struct vspace *, size_t cnt, uintptr_t *start);
+bool vspace_best_fit(struct vspace *, size_t cnt, uintptr_t *start);
+bool vspace_is_free(struct vspace *, uintptr_t start, size_t cnt);
+bool vspace_take(struct vspace *, uintptr_t start, size_t cnt);
+bool vspace_give(struct vspace *, uintptr_t start, size_t cnt);
+size_t vspace_used_run(struct vspace *, uintptr_t *start, uintptr_t end);
+
+#endif /* vm/vspace.h */